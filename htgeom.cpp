@@ -20,12 +20,27 @@
  *
  * ----------------------------------------------------------------------------- */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <queue>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#ifdef HTREE_USE_HOMOG2D
 #include "homog2d.hpp"
+#endif
 
 #include "htgeom.h"
+#include "htgeom_core.h"
+#include "htgeom_internal.h"
 #include "htgeom_types.h"
 
 #ifdef __DEBUG__
@@ -38,6 +53,7 @@
 #define NODE_WIDTH          300
 #define NODE_HEIGHT         200
 
+#ifdef HTREE_USE_HOMOG2D
 /* -----------------------------------------------------------------------------
  * Geometry conversions: lib to homog2d and back
  * ----------------------------------------------------------------------------- */
@@ -146,22 +162,48 @@ HTreePolyline* homog_polyline_to_htree(const h2d::OPolylineD& hgpolyline)
 	return polyline;
 }
 
+#endif
+
+/* -----------------------------------------------------------------------------
+ * Geometry collections
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+	HTreeBox                points;
+	HTreeBox                rects;
+	HTreePoint              first_rect_point;
+	HTreeBox                polylines;
+} HTreeCollections;
+
+static void htree_init_collections(HTreeCollections& c)
+{
+	c.points = c.rects = c.polylines = htree_core_box();
+	c.first_rect_point = htree_core_point(0.0, 0.0);
+}
+
+static void htree_collections_add_rect(HTreeCollections& c, const HTreeRect* rect)
+{
+	if (c.rects.count == 0) {
+		c.first_rect_point = htree_core_point(rect->x, rect->y);
+	}
+	htree_core_box_add(c.rects, *rect);
+}
+
 static int htree_get_nodes_collections(const HTreeNode* nodes,
-									   std::vector<h2d::Point2dD>& points,
-									   std::vector<h2d::FRectD>& rects)
+									   HTreeCollections& c)
 {
 	if (!nodes) {
 		return HTREE_BAD_PARAMETER;
 	}
 	for (const HTreeNode* node = nodes; node; node = node->next) {
 		if (node->point) {
-			points.push_back(htree_point_to_homog(node->point));
+			htree_core_box_add(c.points, *(node->point));
 		}
 		if (node->rect) {
-			rects.push_back(htree_rect_to_homog(node->rect));
+			htree_collections_add_rect(c, node->rect);
 		}
 		if (node->children) {
-			int res = htree_get_nodes_collections(node->children, points, rects);
+			int res = htree_get_nodes_collections(node->children, c);
 			if (res != HTREE_OK) {
 				return res;
 			}
@@ -171,16 +213,14 @@ static int htree_get_nodes_collections(const HTreeNode* nodes,
 }
 
 static int htree_get_tree_collections(const HTree* tree,
-									  std::vector<h2d::Point2dD>& points,
-									  std::vector<h2d::FRectD>& rects,
-									  std::vector<h2d::OPolyline>& polylines)
+									  HTreeCollections& c)
 {
 	if (!tree) {
 		return HTREE_BAD_PARAMETER;
 	}
 
 	if (tree->nodes) {
-		int res = htree_get_nodes_collections(tree->nodes, points, rects);
+		int res = htree_get_nodes_collections(tree->nodes, c);
 		if (res != HTREE_OK) {
 			return res;
 		}
@@ -206,23 +246,26 @@ static int htree_get_tree_collections(const HTree* tree,
 
 				if (edge->target_point) {
 					target = *(edge->target_point);
-				} else if (edge->target->rect) {
-					HTreePoint* center = htree_rect_center_point(edge->target->rect, coordAbsolute);
-					target = *center;
-					htree_destroy_point(center);
-				} else if (edge->target->point) {
-					source = *(edge->target->point);
 				} else {
 					continue;
 				}
-				
-				polylines.push_back(htree_polyline_to_homog(&source, &target, edge->polyline));
+
+				HTreeBox box = htree_core_box();
+				htree_core_box_add(box, source);
+				if (edge->polyline->next) {
+					/* more than one point */
+					for (const HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
+						htree_core_box_add(box, pl->point);
+					}
+				}
+				htree_core_box_add(box, target);
+				htree_core_box_add(c.polylines, box);
 			}
 			if (edge->label_point) {
-				points.push_back(htree_point_to_homog(edge->label_point));
+				htree_core_box_add(c.points, *(edge->label_point));
 			}
 			if (edge->label_rect) {
-				rects.push_back(htree_rect_to_homog(edge->label_rect));
+				htree_collections_add_rect(c, edge->label_rect);
 			}
 		}
 	}
@@ -231,20 +274,16 @@ static int htree_get_tree_collections(const HTree* tree,
 }
 
 static int htree_get_collections(const HTree* trees,
-								 std::vector<h2d::Point2dD>& points,
-								 std::vector<h2d::FRectD>& rects,
-								 std::vector<h2d::OPolyline>& polylines)
+								 HTreeCollections& c)
 {
 	if (!trees) {
 		return HTREE_BAD_PARAMETER;
 	}
 
-	points.clear();
-	rects.clear();
-	polylines.clear();
+	htree_init_collections(c);
 	
 	for (const HTree* tree = trees; tree; tree = tree->next) {
-		int res = htree_get_tree_collections(tree, points, rects, polylines);
+		int res = htree_get_tree_collections(tree, c);
 		if (res != HTREE_OK) return res;
 	}
 
@@ -330,74 +369,164 @@ static int htree_extend_rect(HTreeRect** result, HTreeRect* src)
 	}*/
 
 /* -----------------------------------------------------------------------------
- * Geometry transformations implementation: format to absolute
+ * Conversion kernels: the coordinates format is a template parameter, the
+ * document loops are instantiated once per format and dispatched per call
  * ----------------------------------------------------------------------------- */
 
-static int htree_convert_point_geometry_to_absolute(HTreePoint* point,
-													const HTreePoint* parent,
-													HTCoordFormat format)
-{
-	if (!point) {
-		return HTREE_BAD_PARAMETER;
+template<HTCoordFormat format>
+struct HTreeCoordKernel {
+	/* coordNone & coordAbsolute: nothing to convert */
+	static constexpr bool relative = format == coordLeftTop || format == coordLocalCenter;
+	static constexpr bool center = format == coordLocalCenter;
+
+	static void point_to_absolute(HTreePoint* point, const HTreePoint* parent)
+	{
+		if (!relative || !parent) return ;
+		point->x += parent->x;
+		point->y += parent->y;
 	}
-	if (format == coordNone || format == coordAbsolute) {
-		return HTREE_BAD_PARAMETER;
+
+	static void point_to_absolute(HTreePoint* point, const HTreeRect* parent)
+	{
+		if (!relative || !parent) return ;
+		if (center) {
+			point->x += parent->x + parent->width / 2.0;
+			point->y += parent->y + parent->height / 2.0;
+		} else {
+			point->x += parent->x;
+			point->y += parent->y;
+		}
 	}
-	if (parent == NULL) { // no parent
-		return HTREE_OK;
+
+	static void rect_to_absolute(HTreeRect* rect, const HTreePoint* parent)
+	{
+		if (!relative) return ;
+		rect->x += parent->x;
+		rect->y += parent->y;
 	}
-	point->x += parent->x;
-	point->y += parent->y;
-	return HTREE_OK;
-}
 
-static int htree_convert_point_geometry_to_absolute(HTreePoint* point,
-													const HTreeRect* parent,
-													HTCoordFormat format)
-{
-	if (!point) {
-		return HTREE_BAD_PARAMETER;
+	static void rect_to_absolute(HTreeRect* rect, const HTreeRect* parent)
+	{
+		if (!relative) return ;
+		if (center) {
+			rect->x += parent->x + parent->width / 2.0 - rect->width / 2.0;
+			rect->y += parent->y + parent->height / 2.0 - rect->height / 2.0;
+		} else {
+			rect->x += parent->x;
+			rect->y += parent->y;
+		}
 	}
-	if (format == coordNone || format == coordAbsolute) {
-		return HTREE_BAD_PARAMETER;
+
+	static void point_to_format(HTreePoint* point, const HTreePoint* parent)
+	{
+		if (!relative || !parent) return ;
+		point->x -= parent->x;
+		point->y -= parent->y;
+		snap(point);
 	}
-	if (parent == NULL) { // no parent
-		return HTREE_OK;
+
+	static void point_to_format(HTreePoint* point, const HTreeRect* parent)
+	{
+		if (!relative || !parent) return ;
+		if (center) {
+			point->x -= parent->x + parent->width / 2.0;
+			point->y -= parent->y + parent->height / 2.0;
+		} else {
+			point->x -= parent->x;
+			point->y -= parent->y;
+		}
+		snap(point);
 	}
-	if (format == coordLeftTop) {
-		point->x += parent->x;
-		point->y += parent->y;
+
+	static void rect_to_format(HTreeRect* rect, const HTreePoint* parent)
+	{
+		if (!relative) return ;
+		rect->x -= parent->x;
+		rect->y -= parent->y;
+	}
+
+	static void rect_to_format(HTreeRect* rect, const HTreeRect* parent)
+	{
+		if (!relative) return ;
+		if (center) {
+			rect->x -= parent->x + parent->width / 2.0 - rect->width / 2.0;
+			rect->y -= parent->y + parent->height / 2.0 - rect->height / 2.0;
+		} else {
+			rect->x -= parent->x;
+			rect->y -= parent->y;
+		}
+	}
+
+	static void snap(HTreePoint* point)
+	{
+		if (point->x != 0.0 && abs(point->x) < 0.000001) point->x = 0.0;
+		if (point->y != 0.0 && abs(point->y) < 0.000001) point->y = 0.0;
+	}
+};
+
+/* call func with the kernel instance for the format */
+template<class Func>
+static void htree_with_coord_kernel(HTCoordFormat format, Func&& func)
+{
+	switch (format) {
+	case coordLeftTop:
+		func(HTreeCoordKernel<coordLeftTop>());
+		break;
+	case coordLocalCenter:
+		func(HTreeCoordKernel<coordLocalCenter>());
+		break;
+	default:
+		func(HTreeCoordKernel<coordAbsolute>());
+	}
+}
+
+/* evil hack for yEd format: the edge labels are placed relative to the edge source point */
+static bool htree_yed_edge_labels(HTCoordFormat edge_coord_format,
+								  HTCoordFormat edge_pl_coord_format,
+								  HTEdgeFormat edge_format)
+{
+	return (edge_coord_format == coordLocalCenter &&
+			edge_pl_coord_format == coordAbsolute &&
+			edge_format == edgeCenter);
+}
+
+/* call func with the labels kernel and the yEd hack flag as a type */
+template<class Func>
+static void htree_with_labels_kernel(HTCoordFormat format, bool yed_labels, Func&& func)
+{
+	if (yed_labels) {
+		func(HTreeCoordKernel<coordLocalCenter>(), std::true_type());
 	} else {
-		// format == coordLocalCenter
-		point->x += parent->x + parent->width / 2.0;
-		point->y += parent->y + parent->height / 2.0;
+		htree_with_coord_kernel(format, [&](auto kernel) {
+			func(kernel, std::false_type());
+		});
 	}
-	return HTREE_OK;
 }
 
-static int htree_convert_rect_geometry_to_absolute(HTreeRect* rect,
-												   const HTreeRect* parent,
-												   HTCoordFormat format)
+/* -----------------------------------------------------------------------------
+ * Geometry transformations implementation: format to absolute
+ * ----------------------------------------------------------------------------- */
+
+template<class Parent>
+static int htree_convert_point_geometry_to_absolute(HTreePoint* point,
+													const Parent* parent,
+													HTCoordFormat format)
 {
-	if (!rect) {
+	if (!point) {
 		return HTREE_BAD_PARAMETER;
 	}
 	if (format == coordNone || format == coordAbsolute) {
 		return HTREE_BAD_PARAMETER;
 	}
-	if (format == coordLeftTop) {
-		rect->x += parent->x;
-		rect->y += parent->y;		
-	} else {
-		// format == coordLocalCenter
-		rect->x += parent->x + parent->width / 2.0 - rect->width / 2.0;
-		rect->y += parent->y + parent->height / 2.0 - rect->height / 2.0;
-	}
+	htree_with_coord_kernel(format, [&](auto kernel) {
+		kernel.point_to_absolute(point, parent);
+	});
 	return HTREE_OK;
 }
 
+template<class Parent>
 static int htree_convert_rect_geometry_to_absolute(HTreeRect* rect,
-												   const HTreePoint* parent,
+												   const Parent* parent,
 												   HTCoordFormat format)
 {
 	if (!rect) {
@@ -406,10 +535,9 @@ static int htree_convert_rect_geometry_to_absolute(HTreeRect* rect,
 	if (format == coordNone || format == coordAbsolute) {
 		return HTREE_BAD_PARAMETER;
 	}
-
-	rect->x += parent->x;
-	rect->y += parent->y;		
-
+	htree_with_coord_kernel(format, [&](auto kernel) {
+		kernel.rect_to_absolute(rect, parent);
+	});
 	return HTREE_OK;
 }
 
@@ -452,40 +580,30 @@ static int htree_build_edges_bounding_rect(HTreeEdge* edges,
 	return HTREE_OK;	
 }*/
 
-static int htree_construct_bounding_rect(std::vector<h2d::Point2dD>& points,
-										 std::vector<h2d::FRectD>& rects,
-										 std::vector<h2d::OPolyline>& polylines,
+static int htree_construct_bounding_rect(HTreeCollections& c,
 										 HTreeRect** result)
 {
-	h2d::FRectD br;
+	HTreeBox br = htree_core_box();
 
-/*	DEBUG << "BR points: " << points.size() << " rects: " << rects.size() << " pls: " << polylines.size() << std::endl;
-	if (rects.size() > 0) {
-		DEBUG << "rect: " << rects.front() << std::endl;
-		}*/
+/*	DEBUG << "BR points: " << c.points.count << " rects: " << c.rects.count << " pls: " << c.polylines.count << std::endl;*/
 	
-	if (points.size() == 1 && rects.size() > 0) {
+	if (c.points.count == 1 && c.rects.count > 0) {
 		// in a case of a single point we need to add any other point to have a bounding box
-		h2d::FRectD a_rect = rects.front();
-		h2d::Point2dD a_point = a_rect.getPts().first;
-		points.push_back(a_point);
+		htree_core_box_add(c.points, c.first_rect_point);
 	}
+
+	htree_core_box_add(br, c.rects);
 	
-	if (points.size() > 0) {
-		try {
-			rects.push_back(h2d::getBB(points));
-		} catch (const std::runtime_error& e) {
-		}
+	// the flat boxes are skipped
+	if (htree_core_box_valid(c.points)) {
+		htree_core_box_add(br, c.points);
 	}
 
-	if (polylines.size() > 0) {
-		try {
-			rects.push_back(h2d::getBB(polylines));
-		} catch (const std::runtime_error& e) {
-		}
+	if (htree_core_box_valid(c.polylines)) {
+		htree_core_box_add(br, c.polylines);
 	}
 
-	if (rects.size() == 0) {
+	if (br.count == 0) {
 		// empty bounding rect
 		if (*result) {
 			HTreeRect* r = *result;
@@ -496,18 +614,11 @@ static int htree_construct_bounding_rect(std::vector<h2d::Point2dD>& points,
 		return HTREE_OK;
 	}
 
-	try {
-		br = h2d::getBB(rects);
-	} catch (const std::runtime_error& e) {
-	} 
-
-	//DEBUG << "br rect: " << br << std::endl;
-
 	if (result) {
 		if (!*result) {
 			*result = htree_new_rect();
 		}
-		homog_rect_to_htree(br, **result);
+		**result = htree_core_box_to_rect(br);
 	}
 
 	return HTREE_OK;
@@ -522,14 +633,13 @@ static int htree_build_nodes_bounding_rect(HTreeNode* nodes,
 		return HTREE_BAD_PARAMETER;
 	}
 
-	std::vector<h2d::Point2dD> points;
-	std::vector<h2d::FRectD> rects;
-	std::vector<h2d::OPolyline> polylines;
+	HTreeCollections c;
+	htree_init_collections(c);
 	
-	res = htree_get_nodes_collections(nodes, points, rects);
+	res = htree_get_nodes_collections(nodes, c);
 	if (res != HTREE_OK) return res;
 
-	res = htree_construct_bounding_rect(points, rects, polylines, result);
+	res = htree_construct_bounding_rect(c, result);
 	
 	return res;
 }
@@ -542,14 +652,13 @@ static int htree_build_tree_bounding_rect(HTree* tree,
 		return HTREE_BAD_PARAMETER;
 	}
 
-	std::vector<h2d::Point2dD> points;
-	std::vector<h2d::FRectD> rects;
-	std::vector<h2d::OPolyline> polylines;
+	HTreeCollections c;
+	htree_init_collections(c);
 	
-	res = htree_get_tree_collections(tree, points, rects, polylines);
+	res = htree_get_tree_collections(tree, c);
 	if (res != HTREE_OK) return res;
 
-	res = htree_construct_bounding_rect(points, rects, polylines, result);
+	res = htree_construct_bounding_rect(c, result);
 	
 	return res;
 }
@@ -561,21 +670,21 @@ int htree_build_bounding_rect(HTDocument* doc, HTreeRect** result)
 		return HTREE_BAD_PARAMETER;
 	}
 
-	std::vector<h2d::Point2dD> points;
-	std::vector<h2d::FRectD> rects;
-	std::vector<h2d::OPolyline> polylines;
+	HTreeAllocatorScope scope(doc);
+	HTreeStatsScope stats(statBoundingRect, doc);
+	HTreeCollections c;
 	
-	res = htree_get_collections(doc->trees, points, rects, polylines);
+	res = htree_get_collections(doc->trees, c);
 	if (res != HTREE_OK) return res;
 
-	res = htree_construct_bounding_rect(points, rects, polylines, result);
+	res = htree_construct_bounding_rect(c, result);
 	
 	return res;
 }
 
+template<class Kernel>
 static int htree_convert_node_tree_geometry_to_absolute(HTreeNode* nodes,
-														const HTreeRect* parent,
-														HTCoordFormat format)
+														const HTreeRect* parent)
 {
 	if (!nodes || !parent) {
 		return HTREE_BAD_PARAMETER;
@@ -583,12 +692,12 @@ static int htree_convert_node_tree_geometry_to_absolute(HTreeNode* nodes,
 
 	for (HTreeNode* node = nodes; node; node = node->next) {
 		if (node->point) {
-			//DEBUG << "convert point " << node->point << " with parent " << parent << " and format " << format << std::endl;
-			htree_convert_point_geometry_to_absolute(node->point, parent, format);
+			//DEBUG << "convert point " << node->point << " with parent " << parent << std::endl;
+			Kernel::point_to_absolute(node->point, parent);
 			//DEBUG << "result " << node->point << std::endl;
 		}
 		if (node->rect) {
-			htree_convert_rect_geometry_to_absolute(node->rect, parent, format);
+			Kernel::rect_to_absolute(node->rect, parent);
 		}
 		if (node->children) {
 			const HTreeRect* next_parent;
@@ -597,7 +706,7 @@ static int htree_convert_node_tree_geometry_to_absolute(HTreeNode* nodes,
 			} else {
 				next_parent = parent;
 			}
-			int res = htree_convert_node_tree_geometry_to_absolute(node->children, next_parent, format);
+			int res = htree_convert_node_tree_geometry_to_absolute<Kernel>(node->children, next_parent);
 			if (res != HTREE_OK) {
 				return res;
 			}
@@ -625,13 +734,89 @@ static int htree_convert_nodes_geometry_to_absolute(HTDocument* doc)
 		// DEBUG << "use bounding rect " << doc->bounding_rect << " as parent" << std::endl;
 		htree_set_rect(&parent_rect, doc->bounding_rect);
 	}
-	for (HTree* tree = doc->trees; tree; tree = tree->next) {
-		htree_convert_node_tree_geometry_to_absolute(tree->nodes, &parent_rect, doc->node_coord_format);
+	if (doc->node_coord_format == coordNone || doc->node_coord_format == coordAbsolute) {
+		return HTREE_OK;
 	}
+	htree_with_coord_kernel(doc->node_coord_format, [&](auto kernel) {
+		for (HTree* tree = doc->trees; tree && !htree_task_cancelled(); tree = tree->next) {
+			HTreeTraceScope trace("absolute tree", tree);
+			htree_convert_node_tree_geometry_to_absolute<decltype(kernel)>(tree->nodes, &parent_rect);
+			htree_task_tree_done(tree);
+		}
+	});
 	
 	return HTREE_OK;
 }
 
+template<class EdgeKernel, class PolylineKernel>
+static void htree_convert_edge_geometry_to_absolute_points(HTreeEdge* edge,
+														   const HTreeNode* source,
+														   const HTreeNode* target)
+{
+	if (edge->source_point) {
+		if (source->rect) {
+			EdgeKernel::point_to_absolute(edge->source_point, source->rect);
+		} else {
+			EdgeKernel::point_to_absolute(edge->source_point, source->point);
+		}
+	}
+	if (edge->target_point) {
+		if (target->rect) {
+			EdgeKernel::point_to_absolute(edge->target_point, target->rect);
+		} else {
+			EdgeKernel::point_to_absolute(edge->target_point, target->point);
+		}
+	}
+	if (edge->polyline) {
+		for (HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
+			if (source->rect) {
+				PolylineKernel::point_to_absolute(&(pl->point), source->rect);
+			} else {
+				PolylineKernel::point_to_absolute(&(pl->point), source->point);
+			}
+		}
+	}
+}
+
+static int htree_convert_edge_geometry_to_absolute_points(HTreeEdge* edge,
+														  const HTreeNode* source,
+														  const HTreeNode* target,
+														  HTCoordFormat edge_format,
+														  HTCoordFormat edge_pl_format)
+{
+	htree_with_coord_kernel(edge_format, [&](auto edge_kernel) {
+		htree_with_coord_kernel(edge_pl_format, [&](auto pl_kernel) {
+			htree_convert_edge_geometry_to_absolute_points<decltype(edge_kernel),
+														   decltype(pl_kernel)>(edge, source, target);
+		});
+	});
+	return HTREE_OK;
+}
+
+static void htree_drop_edge_geometry(HTreeEdge* edge)
+{
+	if (edge->source_point) {
+		htree_destroy_point(edge->source_point);
+		edge->source_point = NULL;
+	}
+	if (edge->target_point) {
+		htree_destroy_point(edge->target_point);
+		edge->target_point = NULL;
+	}
+	if (edge->label_point) {
+		htree_destroy_point(edge->label_point);
+		edge->label_point = NULL;
+	}
+	if (edge->label_rect) {
+		htree_destroy_rect(edge->label_rect);
+		edge->label_rect = NULL;
+	}
+	if (edge->polyline) {
+		htree_destroy_polyline(edge->polyline);
+		edge->polyline = NULL;
+	}			
+}
+
 static int htree_convert_edges_geometry_to_absolute_points(HTDocument* doc)
 {
 	if (!doc) {
@@ -642,78 +827,85 @@ static int htree_convert_edges_geometry_to_absolute_points(HTDocument* doc)
 		return HTREE_OK;
 	}
 	
-	for (HTree* tree = doc->trees; tree; tree = tree->next) {
-		for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
-			if (edge->source && (edge->source->rect || edge->source->point) &&
-				edge->target && (edge->target->rect || edge->target->point)) {
-				if (edge->source_point) {
-					if (edge->source->rect) {
-						htree_convert_point_geometry_to_absolute(edge->source_point,
-																 edge->source->rect,
-																 doc->edge_coord_format);
-					} else {
-						htree_convert_point_geometry_to_absolute(edge->source_point,
-																 edge->source->point,
-																 doc->edge_coord_format);
-					}
-				}
-				if (edge->target_point) {
-					if (edge->target->rect) {
-						htree_convert_point_geometry_to_absolute(edge->target_point,
-																 edge->target->rect,
-																 doc->edge_coord_format);
+	htree_with_coord_kernel(doc->edge_coord_format, [&](auto edge_kernel) {
+		htree_with_coord_kernel(doc->edge_pl_coord_format, [&](auto pl_kernel) {
+			for (HTree* tree = doc->trees; tree; tree = tree->next) {
+				for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+					if (edge->source && (edge->source->rect || edge->source->point) &&
+						edge->target && (edge->target->rect || edge->target->point)) {
+						htree_convert_edge_geometry_to_absolute_points<decltype(edge_kernel),
+																	   decltype(pl_kernel)>(edge,
+																							edge->source,
+																							edge->target);
 					} else {
-						htree_convert_point_geometry_to_absolute(edge->target_point,
-																 edge->target->point,
-																 doc->edge_coord_format);
-					}
-				}
-				if (edge->polyline) {
-					for (HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
-						if (edge->source->rect) {
-							htree_convert_point_geometry_to_absolute(&(pl->point),
-																	 edge->source->rect,
-																	 doc->edge_pl_coord_format);
-						} else {
-							htree_convert_point_geometry_to_absolute(&(pl->point),
-																	 edge->source->point,
-																	 doc->edge_pl_coord_format);
-						}
+						// drop edge geometry if invalid
+						htree_drop_edge_geometry(edge);
 					}
 				}
-			} else {
-				// drop edge geometry if invalid
-				if (edge->source_point) {
-					htree_destroy_point(edge->source_point);
-					edge->source_point = NULL;
-				}
-				if (edge->target_point) {
-					htree_destroy_point(edge->target_point);
-					edge->target_point = NULL;
-				}
-				if (edge->label_point) {
-					htree_destroy_point(edge->label_point);
-					edge->label_point = NULL;
-				}
-				if (edge->label_rect) {
-					htree_destroy_rect(edge->label_rect);
-					edge->label_rect = NULL;
-				}
-				if (edge->polyline) {
-					htree_destroy_polyline(edge->polyline);
-					edge->polyline = NULL;
-				}			
 			}
+		});
+	});
+
+	return HTREE_OK;
+}
+
+static int htree_convert_edge_geometry_to_absolute_borders(HTreeEdge* edge,
+														   const HTreeNode* source,
+														   const HTreeNode* target)
+{
+	if (!edge->source_point) {
+		if (source->rect) {
+			edge->source_point = htree_rect_center_point(source->rect, coordAbsolute);
+		} else {
+			edge->source_point = htree_copy_point(source->point);
+		}
+	}
+	if (!edge->target_point) {
+		if (target->rect) {
+			edge->target_point = htree_rect_center_point(target->rect, coordAbsolute);
+		} else {
+			edge->target_point = htree_copy_point(target->point);
+		}
+	}
+
+	HTreeSegment from_segment, to_segment;
+	if (!edge->polyline) {
+		from_segment = to_segment = htree_core_segment(*(edge->source_point), *(edge->target_point));
+		//DEBUG << "converted from " << edge->source_point << " -> " << edge->target_point << std::endl;
+	} else {
+		const HTreePolyline* pl = edge->polyline;
+		while (pl->next) {
+			pl = pl->next;
+		}
+		from_segment = htree_core_segment(*(edge->source_point), edge->polyline->point);
+		to_segment = htree_core_segment(pl->point, *(edge->target_point));
+	}
+
+	HTreePoint crossing[4];
+
+	if (source->rect) {
+		if (htree_core_segment_rect_intersections(from_segment, *(source->rect), crossing) >= 1) {
+			*(edge->source_point) = crossing[0];
 		}
 	}
 
+	if (target->rect) {
+		if (htree_core_segment_rect_intersections(to_segment, *(target->rect), crossing) >= 1) {
+			*(edge->target_point) = crossing[0];
+		}
+	}
+
+	//if (from_segment == to_segment) {
+	//DEBUG << "converted to " << edge->source_point << " -> " << edge->target_point << std::endl;
+	//} else {
+	//DEBUG << "converted to " << edge->source_point << " ; " << edge->target_point << std::endl;
+	//}
+
 	return HTREE_OK;
 }
 
 static int htree_convert_edges_geometry_to_absolute_borders(HTDocument* doc)
 {
-	int res;
-	
 	if (!doc) {
 		return HTREE_BAD_PARAMETER;
 	}
@@ -724,64 +916,7 @@ static int htree_convert_edges_geometry_to_absolute_borders(HTDocument* doc)
 		for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
 			if (edge->source && (edge->source->rect || edge->source->point) &&
 				edge->target && (edge->target->rect || edge->target->point)) {
-				if (!edge->source_point) {
-					if (edge->source->rect) {
-						edge->source_point = htree_rect_center_point(edge->source->rect, coordAbsolute);
-					} else {
-						edge->source_point = htree_copy_point(edge->source->point);
-					}
-				}
-				if (!edge->target_point) {
-					if (edge->target->rect) {
-						edge->target_point = htree_rect_center_point(edge->target->rect, coordAbsolute);
-					} else {
-						edge->target_point = htree_copy_point(edge->target->point);
-					}
-				}
-
-				h2d::Point2dD from_point = htree_point_to_homog(edge->source_point);
-				h2d::Point2dD to_point = htree_point_to_homog(edge->target_point);
-
-				//DEBUG << "convert edge from " << from_point << " to " << to_point << std::endl;
-				
-				h2d::SegmentD from_segment, to_segment;
-				if (!edge->polyline) {
-					from_segment = to_segment = h2d::SegmentD(from_point, to_point);
-					//DEBUG << "converted from " << edge->source_point << " -> " << edge->target_point << std::endl;
-				} else {
-					h2d::Point2dD first_point = htree_point_to_homog(&(edge->polyline->point));
-					HTreePolyline* pl = edge->polyline;
-					while (pl->next) {
-						pl = pl->next;
-					}
-					h2d::Point2dD last_point = htree_point_to_homog(&(pl->point));
-					from_segment = h2d::SegmentD(from_point, first_point);
-					to_segment = h2d::SegmentD(last_point, to_point);
-					//DEBUG << "converted from " << from_point << " -> " << first_point << std::endl;
-					//DEBUG << "converted from " << last_point << " -> " << to_point << std::endl;
-				}
-
-				if (edge->source->rect) {
-					h2d::FRectD from_rect = htree_rect_to_homog(edge->source->rect);
-					auto res = from_segment.intersects(from_rect);
-					if (res() && res.get().size() >= 1) {
-						homog_point_to_htree(res.get().front(), *edge->source_point);
-					}
-				}
-
-				if (edge->target->rect) {
-					h2d::FRectD to_rect = htree_rect_to_homog(edge->target->rect);
-					auto res = to_segment.intersects(to_rect);
-					if (res() && res.get().size() >= 1) {
-						homog_point_to_htree(res.get().front(), *edge->target_point);
-					}
-				}
-
-				//if (from_segment == to_segment) {
-					//DEBUG << "converted to " << edge->source_point << " -> " << edge->target_point << std::endl;
-				//} else {
-					//DEBUG << "converted to " << edge->source_point << " ; " << edge->target_point << std::endl;
-				//}
+				htree_convert_edge_geometry_to_absolute_borders(edge, edge->source, edge->target);
 			}
 		}
 	}	
@@ -789,55 +924,70 @@ static int htree_convert_edges_geometry_to_absolute_borders(HTDocument* doc)
 	return HTREE_OK;
 }
 
+template<class Kernel, bool yed_labels>
+static void htree_convert_edge_geometry_to_absolute_labels(HTreeEdge* edge,
+														   const HTreeNode* source)
+{
+	if (edge->label_point) {
+		if (yed_labels) {
+			Kernel::point_to_absolute(edge->label_point, edge->source_point);
+		} else if (source->rect) {
+			Kernel::point_to_absolute(edge->label_point, source->rect);
+		} else {
+			Kernel::point_to_absolute(edge->label_point, source->point);
+		}
+	}
+	if (edge->label_rect) {
+		if (source->rect) {
+			Kernel::rect_to_absolute(edge->label_rect, source->rect);
+		} else {
+			Kernel::rect_to_absolute(edge->label_rect, source->point);
+		}
+	}
+}
+
+static bool htree_yed_absolute_edge_labels(const HTDocument* doc)
+{
+	return (doc->node_coord_format == coordAbsolute &&
+			htree_yed_edge_labels(doc->edge_coord_format,
+								  doc->edge_pl_coord_format,
+								  doc->edge_format));
+}
+
+static int htree_convert_edge_geometry_to_absolute_labels(HTreeEdge* edge,
+														  const HTreeNode* source,
+														  const HTDocument* doc)
+{
+	htree_with_labels_kernel(doc->edge_coord_format, htree_yed_absolute_edge_labels(doc),
+							 [&](auto kernel, auto yed) {
+		htree_convert_edge_geometry_to_absolute_labels<decltype(kernel), decltype(yed)::value>(edge, source);
+	});
+	return HTREE_OK;
+}
+
 static int htree_convert_edges_geometry_to_absolute_labels(HTDocument* doc)
 {
 	if (!doc) {
 		return HTREE_BAD_PARAMETER;
 	}
 	
-	for (HTree* tree = doc->trees; tree; tree = tree->next) {
-		for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
-			if (edge->source && (edge->source->rect || edge->source->point) &&
-				edge->target && (edge->target->rect || edge->target->point)) {
-				
-				if (edge->label_point) {
-					// evil hack for yEd format
-					if (doc->node_coord_format == coordAbsolute &&
-						doc->edge_coord_format == coordLocalCenter &&
-						doc->edge_pl_coord_format == coordAbsolute &&
-						doc->edge_format == edgeCenter) {
-
-						htree_convert_point_geometry_to_absolute(edge->label_point,
-																 edge->source_point,
-																 doc->edge_coord_format);						
-					} else if (edge->source->rect) {
-						htree_convert_point_geometry_to_absolute(edge->label_point,
-																 edge->source->rect,
-																 doc->edge_coord_format);
-					} else {
-						htree_convert_point_geometry_to_absolute(edge->label_point,
-																 edge->source->point,
-																 doc->edge_coord_format);
-					}
-				}
-				if (edge->label_rect) {
-					if (edge->source->rect) {
-						htree_convert_rect_geometry_to_absolute(edge->label_rect,
-																edge->source->rect,
-																doc->edge_coord_format);
-					} else {
-						htree_convert_rect_geometry_to_absolute(edge->label_rect,
-																edge->source->point,
-																doc->edge_coord_format);
-					}
+	htree_with_labels_kernel(doc->edge_coord_format, htree_yed_absolute_edge_labels(doc),
+							 [&](auto kernel, auto yed) {
+		for (HTree* tree = doc->trees; tree; tree = tree->next) {
+			for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+				if (edge->source && (edge->source->rect || edge->source->point) &&
+					edge->target && (edge->target->rect || edge->target->point)) {
+					htree_convert_edge_geometry_to_absolute_labels<decltype(kernel),
+																   decltype(yed)::value>(edge, edge->source);
 				}
 			}
 		}
-	}
+	});
 
 	return HTREE_OK;
 }
 
+/* the edge points should be converted before */
 static int htree_convert_edges_geometry_to_absolute(HTDocument* doc)
 {
 	int res;
@@ -846,22 +996,17 @@ static int htree_convert_edges_geometry_to_absolute(HTDocument* doc)
 		return HTREE_BAD_PARAMETER;
 	}
 
-	if (doc->edge_coord_format != coordAbsolute || doc->edge_pl_coord_format != coordAbsolute) {
-		res = htree_convert_edges_geometry_to_absolute_points(doc);
-		if (res != HTREE_OK) {
-			return res;
-		}
-	}
-	
 	//DEBUG << "convert edge geometry " << doc->edge_format << std::endl;
 
 	if (doc->edge_format != edgeBorder) {
+		HTreeStatsScope stats(statBorders, doc);
 		res = htree_convert_edges_geometry_to_absolute_borders(doc);
 		if (res != HTREE_OK) {
 			return res;
 		}
 	}
 
+	HTreeStatsScope stats(statLabels, doc);
 	return htree_convert_edges_geometry_to_absolute_labels(doc);
 }
 
@@ -871,9 +1016,18 @@ static int htree_convert_document_geometry_to_absolute(HTDocument* doc)
 	if (!doc) {
 		return HTREE_BAD_PARAMETER;
 	}
-	res = htree_convert_nodes_geometry_to_absolute(doc);
-	if (res != HTREE_OK) {
-		return res;
+	{
+		HTreeStatsScope stats(statAbsolute, doc);
+		res = htree_convert_nodes_geometry_to_absolute(doc);
+		if (res != HTREE_OK) {
+			return res;
+		}
+		if (doc->edge_coord_format != coordAbsolute || doc->edge_pl_coord_format != coordAbsolute) {
+			res = htree_convert_edges_geometry_to_absolute_points(doc);
+			if (res != HTREE_OK) {
+				return res;
+			}
+		}
 	}
 	
 /*	for (HTree* tree = doc->trees; tree; tree = tree->next) {
@@ -908,8 +1062,9 @@ static int htree_convert_document_geometry_to_absolute(HTDocument* doc)
  * Geometry transformations implementation: absolute to format
  * ----------------------------------------------------------------------------- */
 
+template<class Parent>
 static int htree_convert_point_geometry_to_format(HTreePoint* point,
-												  HTreePoint* parent,
+												  const Parent* parent,
 												  HTCoordFormat format)
 {
 	if (!point) {
@@ -918,88 +1073,32 @@ static int htree_convert_point_geometry_to_format(HTreePoint* point,
 	if (format == coordNone || format == coordAbsolute) {
 		return HTREE_BAD_PARAMETER;
 	}
-	if (parent == NULL) { // no parent
-		return HTREE_OK;
-	}
-
-	point->x -= parent->x;
-	point->y -= parent->y;
-
-	if (point->x != 0.0 && abs(point->x) < 0.000001) point->x = 0.0;
-	if (point->y != 0.0 && abs(point->y) < 0.000001) point->y = 0.0;
-	
+	htree_with_coord_kernel(format, [&](auto kernel) {
+		kernel.point_to_format(point, parent);
+	});
 	return HTREE_OK;
 }
 
-static int htree_convert_point_geometry_to_format(HTreePoint* point,
-												  HTreeRect* parent,
-												  HTCoordFormat format)
+template<class Parent>
+static int htree_convert_rect_geometry_to_format(HTreeRect* rect,
+												 const Parent* parent,
+												 HTCoordFormat new_format)
 {
-	if (!point) {
+	if (!rect) {
 		return HTREE_BAD_PARAMETER;
 	}
-	if (format == coordNone || format == coordAbsolute) {
+	if (new_format == coordNone || new_format == coordAbsolute) {
 		return HTREE_BAD_PARAMETER;
 	}
-	if (parent == NULL) { // no parent
-		return HTREE_OK;
-	}
-	if (format == coordLeftTop) {
-		point->x -= parent->x;
-		point->y -= parent->y;
-	} else {
-		// format == coordLocalCenter
-		point->x -= parent->x + parent->width / 2.0;
-		point->y -= parent->y + parent->height / 2.0;
-	}
-
-	if (point->x != 0.0 && abs(point->x) < 0.000001) point->x = 0.0;
-	if (point->y != 0.0 && abs(point->y) < 0.000001) point->y = 0.0;
-	
+	htree_with_coord_kernel(new_format, [&](auto kernel) {
+		kernel.rect_to_format(rect, parent);
+	});
 	return HTREE_OK;
 }
 
-static int htree_convert_rect_geometry_to_format(HTreeRect* rect,
-												 HTreePoint* parent,
-												 HTCoordFormat new_format)
-{
-	if (!rect) {
-		return HTREE_BAD_PARAMETER;
-	}
-	if (new_format == coordNone || new_format == coordAbsolute) {
-		return HTREE_BAD_PARAMETER;
-	}
-
-	rect->x -= parent->x;
-	rect->y -= parent->y;		
-
-	return HTREE_OK;
-}
-
-static int htree_convert_rect_geometry_to_format(HTreeRect* rect,
-												 HTreeRect* parent,
-												 HTCoordFormat new_format)
-{
-	if (!rect) {
-		return HTREE_BAD_PARAMETER;
-	}
-	if (new_format == coordNone || new_format == coordAbsolute) {
-		return HTREE_BAD_PARAMETER;
-	}
-	if (new_format == coordLeftTop) {
-		rect->x -= parent->x;
-		rect->y -= parent->y;		
-	} else {
-		// new_format == coordLocalCenter
-		rect->x -= parent->x + parent->width / 2.0 - rect->width / 2.0;
-		rect->y -= parent->y + parent->height / 2.0 - rect->height / 2.0;
-	}
-	return HTREE_OK;
-}
-
-static int htree_convert_node_tree_geometry_to_format(HTreeNode* nodes,
-													  HTreeRect* parent,
-													  HTCoordFormat format)
+template<class Kernel>
+static int htree_convert_node_tree_geometry_to_format(HTreeNode* nodes,
+													  const HTreeRect* parent)
 {
 	if (!nodes || !parent) {
 		return HTREE_BAD_PARAMETER;
@@ -1007,22 +1106,22 @@ static int htree_convert_node_tree_geometry_to_format(HTreeNode* nodes,
 
 	for (HTreeNode* node = nodes; node; node = node->next) {
 		if (node->children) {
-			HTreeRect* next_parent;
+			const HTreeRect* next_parent;
 			if (node->rect) {
 				next_parent = node->rect;
 			} else {
 				next_parent = parent;
 			}
-			int res = htree_convert_node_tree_geometry_to_format(node->children, next_parent, format);
+			int res = htree_convert_node_tree_geometry_to_format<Kernel>(node->children, next_parent);
 			if (res != HTREE_OK) {
 				return res;
 			}
 		}
 		if (node->point) {
-			htree_convert_point_geometry_to_format(node->point, parent, format);
+			Kernel::point_to_format(node->point, parent);
 		}
 		if (node->rect) {
-			htree_convert_rect_geometry_to_format(node->rect, parent, format);
+			Kernel::rect_to_format(node->rect, parent);
 		}
 	}
 	
@@ -1038,20 +1137,53 @@ static int htree_convert_nodes_geometry_to_format(HTDocument* doc,
 	if (doc->node_coord_format == new_format) {
 		return HTREE_OK;
 	}
+	if (new_format == coordNone || new_format == coordAbsolute) {
+		return HTREE_OK;
+	}
 
 	HTreeRect parent_rect;
 	htree_init_rect(&parent_rect);
 	if (new_format == coordLocalCenter && doc->bounding_rect && !htree_has_toplevel_rect(doc)) {
 		htree_set_rect(&parent_rect, doc->bounding_rect);
 	}
-	for (HTree* tree = doc->trees; tree; tree = tree->next) {
-		htree_convert_node_tree_geometry_to_format(tree->nodes,
-												   &parent_rect,
-												   new_format);
-	}
+	htree_with_coord_kernel(new_format, [&](auto kernel) {
+		for (HTree* tree = doc->trees; tree && !htree_task_cancelled(); tree = tree->next) {
+			HTreeTraceScope trace("format tree", tree);
+			htree_convert_node_tree_geometry_to_format<decltype(kernel)>(tree->nodes, &parent_rect);
+			htree_task_tree_done(tree);
+		}
+	});
 	return HTREE_OK;
 }
 
+template<class EdgeKernel, class PolylineKernel>
+static void htree_convert_edge_geometry_to_format_points(HTreeEdge* edge)
+{
+	if (edge->source_point) {
+		if (edge->source->rect) {
+			EdgeKernel::point_to_format(edge->source_point, edge->source->rect);
+		} else {
+			EdgeKernel::point_to_format(edge->source_point, edge->source->point);
+		}
+	}
+	if (edge->target_point) {
+		if (edge->target->rect) {
+			EdgeKernel::point_to_format(edge->target_point, edge->target->rect);
+		} else {
+			EdgeKernel::point_to_format(edge->target_point, edge->target->point);
+		}
+	}
+	if (edge->polyline) {
+		for (HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
+			if (edge->source->rect) {
+				PolylineKernel::point_to_format(&(pl->point), edge->source->rect);
+			} else {
+				PolylineKernel::point_to_format(&(pl->point), edge->source->point);
+			}
+		}
+	}
+}
+
 static int htree_convert_edges_geometry_to_format_points(HTDocument* doc,
 														 HTCoordFormat edge_format,
 														 HTCoordFormat edge_pl_format)
@@ -1062,48 +1194,19 @@ static int htree_convert_edges_geometry_to_format_points(HTDocument* doc,
 
 	//DEBUG << "convert edge point from format " << doc->edge_coord_format << " to format " << edge_format << std::endl;
 	
-	for (HTree* tree = doc->trees; tree; tree = tree->next) {
-		for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
-			if (edge->source && (edge->source->rect || edge->source->point) &&
-				edge->target && (edge->target->rect || edge->target->point)) {
-				if (edge->source_point) {
-					if (edge->source->rect) {
-						htree_convert_point_geometry_to_format(edge->source_point,
-															   edge->source->rect,
-															   edge_format);
-					} else {
-						htree_convert_point_geometry_to_format(edge->source_point,
-															   edge->source->point,
-															   edge_format);
-					}
-				}
-				if (edge->target_point) {
-					if (edge->target->rect) {
-						htree_convert_point_geometry_to_format(edge->target_point,
-															   edge->target->rect,
-															   edge_format);
-					} else {
-						htree_convert_point_geometry_to_format(edge->target_point,
-															   edge->target->point	,
-															   edge_format);
-					}
-				}
-				if (edge->polyline) {
-					for (HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
-						if (edge->source->rect) {
-							htree_convert_point_geometry_to_format(&(pl->point),
-																   edge->source->rect,
-																   edge_pl_format);
-						} else {
-							htree_convert_point_geometry_to_format(&(pl->point),
-																   edge->source->point,
-																   edge_pl_format);
-						}
+	htree_with_coord_kernel(edge_format, [&](auto edge_kernel) {
+		htree_with_coord_kernel(edge_pl_format, [&](auto pl_kernel) {
+			for (HTree* tree = doc->trees; tree; tree = tree->next) {
+				for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+					if (edge->source && (edge->source->rect || edge->source->point) &&
+						edge->target && (edge->target->rect || edge->target->point)) {
+						htree_convert_edge_geometry_to_format_points<decltype(edge_kernel),
+																	 decltype(pl_kernel)>(edge);
 					}
 				}
 			}
-		}
-	}
+		});
+	});
 
 	return HTREE_OK;
 }
@@ -1208,6 +1311,27 @@ static int htree_convert_edges_geometry_to_format_points(HTDocument* doc,
 	return HTREE_OK;
 	}*/
 
+template<class Kernel, bool yed_labels>
+static void htree_convert_edge_geometry_to_format_labels(HTreeEdge* edge)
+{
+	if (edge->label_point) {
+		if (yed_labels) {
+			Kernel::point_to_format(edge->label_point, edge->source_point);
+		} else if (edge->source->rect) {
+			Kernel::point_to_format(edge->label_point, edge->source->rect);
+		} else {
+			Kernel::point_to_format(edge->label_point, edge->source->point);
+		}
+	}
+	if (edge->label_rect) {
+		if (edge->source->rect) {
+			Kernel::rect_to_format(edge->label_rect, edge->source->rect);
+		} else {
+			Kernel::rect_to_format(edge->label_rect, edge->source->point);
+		}
+	}
+}
+
 static int htree_convert_edges_geometry_to_format_labels(HTDocument* doc,
 														 HTCoordFormat new_format,
 														 HTCoordFormat new_pl_format,
@@ -1217,44 +1341,18 @@ static int htree_convert_edges_geometry_to_format_labels(HTDocument* doc,
 		return HTREE_BAD_PARAMETER;
 	}
 	
-	for (HTree* tree = doc->trees; tree; tree = tree->next) {
-		for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
-			if (edge->source && (edge->source->rect || edge->source->point) &&
-				edge->target && (edge->target->rect || edge->target->point)) {
-				
-				if (edge->label_point) {
-					// evil hack for yEd format
-					if (new_format == coordLocalCenter &&
-						new_pl_format == coordAbsolute &&
-						new_edge_format == edgeCenter) {
-
-						htree_convert_point_geometry_to_format(edge->label_point,
-															   edge->source_point,
-															   new_format);						
-					} else if (edge->source->rect) {
-						htree_convert_point_geometry_to_format(edge->label_point,
-															   edge->source->rect,
-															   new_format);
-					} else {
-						htree_convert_point_geometry_to_format(edge->label_point,
-															   edge->source->point,
-															   new_format);
-					}
-				}
-				if (edge->label_rect) {
-					if (edge->source->rect) {
-						htree_convert_rect_geometry_to_format(edge->label_rect,
-															  edge->source->rect,
-															  new_format);
-					} else {
-						htree_convert_rect_geometry_to_format(edge->label_rect,
-															  edge->source->point,
-															  new_format);
-					}
+	htree_with_labels_kernel(new_format, htree_yed_edge_labels(new_format, new_pl_format, new_edge_format),
+							 [&](auto kernel, auto yed) {
+		for (HTree* tree = doc->trees; tree; tree = tree->next) {
+			for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+				if (edge->source && (edge->source->rect || edge->source->point) &&
+					edge->target && (edge->target->rect || edge->target->point)) {
+					htree_convert_edge_geometry_to_format_labels<decltype(kernel),
+																 decltype(yed)::value>(edge);
 				}
 			}
 		}
-	}
+	});
 
 	return HTREE_OK;
 }
@@ -1308,6 +1406,7 @@ static int htree_convert_document_geometry_to_format(HTDocument* doc,
 	if (!doc->bounding_rect) {
 		return HTREE_BAD_PARAMETER;
 	}
+	HTreeStatsScope stats(statFormat, doc);
 	res = htree_convert_edges_geometry_to_format(doc, new_edge_coord_format,
 												 new_edge_pl_coord_format, new_edge_format);
 	if (res != HTREE_OK) {
@@ -1404,6 +1503,13 @@ int htree_reconstruct_document_geometry(HTDocument* doc, int reconstruct_sm)
 		return HTREE_BAD_PARAMETER;
 	}
 
+	HTreeAllocatorScope scope(doc);
+	HTreeTraceScope trace("reconstruct document", doc);
+
+	if (doc->offsets_cache) {
+		htree_drop_offsets_cache(doc);
+	}
+
 	//DEBUG << "Reconstruct document geometry" << std::endl;
 	//htree_print_document(doc);
 	
@@ -1414,9 +1520,14 @@ int htree_reconstruct_document_geometry(HTDocument* doc, int reconstruct_sm)
 
 	htree_convert_document_geometry_to_absolute(doc);
 
-	for (HTree* tree = doc->trees; tree; tree = tree->next) {
-		htree_reconstruct_nodes_geometry(tree->nodes, reconstruct_sm);
-		htree_reconstruct_edges_geometry(tree->edges);
+	{
+		HTreeStatsScope stats(statReconstruct, doc);
+		for (HTree* tree = doc->trees; tree && !htree_task_cancelled(); tree = tree->next) {
+			HTreeTraceScope trace("reconstruct tree", tree);
+			htree_reconstruct_nodes_geometry(tree->nodes, reconstruct_sm);
+			htree_reconstruct_edges_geometry(tree->edges);
+			htree_task_tree_done(tree);
+		}
 	}
 
 	if (doc->bounding_rect) {
@@ -1447,6 +1558,13 @@ int htree_convert_document_geometry(HTDocument* doc,
 		return HTREE_BAD_PARAMETER;
 	}
 
+	HTreeAllocatorScope scope(doc);
+	HTreeTraceScope trace("convert document", doc);
+
+	if (doc->offsets_cache) {
+		htree_drop_offsets_cache(doc);
+	}
+
 /*	DEBUG << "Start format: node coord " << doc->node_coord_format <<
 		" edge coord " << doc->edge_coord_format <<
 		" edge coord " << doc->edge_pl_coord_format <<
@@ -1484,3 +1602,2290 @@ int htree_convert_document_geometry(HTDocument* doc,
 	
 	return HTREE_OK;
 }
+
+int htree_convert_documents_geometry(HTConvertJob* jobs, size_t count, unsigned int threads)
+{
+	if (!jobs) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	htree_parallel_for(count, threads, [jobs](size_t i) {
+		HTConvertJob& job = jobs[i];
+		job.result = htree_convert_document_geometry(job.doc,
+													 job.node_coord_format,
+													 job.edge_coord_format,
+													 job.edge_pl_coord_format,
+													 job.edge_format);
+	});
+
+	for (size_t i = 0; i < count; i++) {
+		if (jobs[i].result != HTREE_OK) {
+			return jobs[i].result;
+		}
+	}
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Absolute geometry on demand
+ * ----------------------------------------------------------------------------- */
+
+typedef HTreeMap<const HTreeNode*, HTreeRect> HTreeOffsetsCacheMap;
+
+typedef struct _HTreeOffsetsCache {
+	HTreeRect               top;                   /* the top-level parent rect */
+	HTreeOffsetsCacheMap    frames;                /* the absolute parent rects of the nodes */
+} HTreeOffsetsCache;
+
+static void htree_document_top_rect(const HTDocument* doc, HTreeRect* top)
+{
+	htree_init_rect(top);
+	if (doc->node_coord_format == coordLocalCenter && doc->bounding_rect && !htree_has_toplevel_rect(doc)) {
+		HTreeRect parent_rect;
+		htree_init_rect(&parent_rect);
+		htree_set_rect(top, doc->bounding_rect);
+		htree_convert_rect_geometry_to_absolute(top, &parent_rect, coordLocalCenter);
+	}
+}
+
+/* the absolute rect the node geometry is relative to */
+static void htree_node_frame_rect(const HTDocument* doc, const HTreeNode* node, HTreeRect* frame)
+{
+	if (doc->offsets_cache) {
+		auto i = doc->offsets_cache->frames.find(node);
+		if (i != doc->offsets_cache->frames.end()) {
+			*frame = i->second;
+			return ;
+		}
+	}
+	const HTreeNode* parent = node->parent;
+	while (parent && !parent->rect) {
+		parent = parent->parent;
+	}
+	if (!parent) {
+		if (doc->offsets_cache) {
+			*frame = doc->offsets_cache->top;
+		} else {
+			htree_document_top_rect(doc, frame);
+		}
+		return ;
+	}
+	HTreeRect parent_frame;
+	htree_node_frame_rect(doc, parent, &parent_frame);
+	*frame = *(parent->rect);
+	htree_convert_rect_geometry_to_absolute(frame, &parent_frame, doc->node_coord_format);
+}
+
+int htree_node_absolute_rect(const HTDocument* doc, const HTreeNode* node, HTreeRect* result)
+{
+	HTreeRect frame;
+	if (!doc || !node || !result) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (!node->rect) {
+		return HTREE_NOT_FOUND;
+	}
+	htree_node_frame_rect(doc, node, &frame);
+	*result = *(node->rect);
+	htree_convert_rect_geometry_to_absolute(result, &frame, doc->node_coord_format);
+	return HTREE_OK;
+}
+
+int htree_node_absolute_point(const HTDocument* doc, const HTreeNode* node, HTreePoint* result)
+{
+	HTreeRect frame;
+	if (!doc || !node || !result) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (!node->point) {
+		return HTREE_NOT_FOUND;
+	}
+	htree_node_frame_rect(doc, node, &frame);
+	*result = *(node->point);
+	htree_convert_point_geometry_to_absolute(result, &frame, doc->node_coord_format);
+	return HTREE_OK;
+}
+
+/* fill the node copy having the absolute geometry only */
+static int htree_node_absolute_geometry(const HTDocument* doc, const HTreeNode* node,
+										HTreeNode* abs_node, HTreeRect* rect, HTreePoint* point)
+{
+	memset(abs_node, 0, sizeof(HTreeNode));
+	if (node->rect) {
+		htree_node_absolute_rect(doc, node, rect);
+		abs_node->rect = rect;
+	} else if (node->point) {
+		htree_node_absolute_point(doc, node, point);
+		abs_node->point = point;
+	} else {
+		return HTREE_NOT_FOUND;
+	}
+	return HTREE_OK;
+}
+
+static void htree_node_absolute_center(const HTreeNode* abs_node, HTreePoint* center)
+{
+	if (abs_node->rect) {
+		center->x = abs_node->rect->x + abs_node->rect->width / 2.0;
+		center->y = abs_node->rect->y + abs_node->rect->height / 2.0;
+	} else {
+		*center = *(abs_node->point);
+	}
+}
+
+int htree_edge_absolute_points(const HTDocument* doc, const HTreeEdge* edge,
+							   HTreePoint* source, HTreePoint* target,
+							   HTreePolyline** polyline)
+{
+	HTreeNode abs_source, abs_target;
+	HTreeRect source_rect, target_rect;
+	HTreePoint source_point, target_point;
+	HTreeEdge e;
+	
+	if (!doc || !edge || !source || !target) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (!edge->source || !edge->target ||
+		htree_node_absolute_geometry(doc, edge->source, &abs_source,
+									 &source_rect, &source_point) != HTREE_OK ||
+		htree_node_absolute_geometry(doc, edge->target, &abs_target,
+									 &target_rect, &target_point) != HTREE_OK) {
+		return HTREE_NOT_FOUND;
+	}
+
+	memset(&e, 0, sizeof(HTreeEdge));
+	if (edge->source_point) {
+		*source = *(edge->source_point);
+		e.source_point = source;
+	}
+	if (edge->target_point) {
+		*target = *(edge->target_point);
+		e.target_point = target;
+	}
+	if (edge->polyline) {
+		e.polyline = htree_copy_polyline(edge->polyline);
+	}
+	
+	htree_convert_edge_geometry_to_absolute_points(&e, &abs_source, &abs_target,
+												   doc->edge_coord_format,
+												   doc->edge_pl_coord_format);
+
+	/* the missing points are bound to the nodes' centers */
+	if (!e.source_point) {
+		htree_node_absolute_center(&abs_source, source);
+		e.source_point = source;
+	}
+	if (!e.target_point) {
+		htree_node_absolute_center(&abs_target, target);
+		e.target_point = target;
+	}
+	if (doc->edge_format != edgeBorder) {
+		htree_convert_edge_geometry_to_absolute_borders(&e, &abs_source, &abs_target);
+	}
+
+	if (polyline) {
+		*polyline = e.polyline;
+	} else if (e.polyline) {
+		htree_destroy_polyline(e.polyline);
+	}
+	
+	return HTREE_OK;
+}
+
+int htree_edge_absolute_label(const HTDocument* doc, const HTreeEdge* edge,
+							  HTreePoint* label_point, HTreeRect* label_rect)
+{
+	HTreeNode abs_source;
+	HTreeRect source_rect;
+	HTreePoint source_point, source, target;
+	HTreePoint point;
+	HTreeRect rect;
+	HTreeEdge e;
+	int res;
+	
+	if (!doc || !edge) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (!edge->label_point && !edge->label_rect) {
+		return HTREE_NOT_FOUND;
+	}
+	res = htree_edge_absolute_points(doc, edge, &source, &target, NULL);
+	if (res != HTREE_OK) {
+		return res;
+	}
+	htree_node_absolute_geometry(doc, edge->source, &abs_source, &source_rect, &source_point);
+	
+	memset(&e, 0, sizeof(HTreeEdge));
+	e.source_point = &source;
+	e.target_point = &target;
+	if (edge->label_point) {
+		point = *(edge->label_point);
+		e.label_point = &point;
+	}
+	if (edge->label_rect) {
+		rect = *(edge->label_rect);
+		e.label_rect = &rect;
+	}
+	htree_convert_edge_geometry_to_absolute_labels(&e, &abs_source, doc);
+
+	if (label_point && e.label_point) {
+		*label_point = point;
+	}
+	if (label_rect && e.label_rect) {
+		*label_rect = rect;
+	}
+	
+	return HTREE_OK;
+}
+
+static void htree_build_nodes_offsets_cache(HTreeOffsetsCacheMap& frames,
+											const HTreeNode* nodes,
+											const HTreeRect* frame,
+											HTCoordFormat format)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		frames[node] = *frame;
+		if (node->children) {
+			if (node->rect) {
+				HTreeRect rect = *(node->rect);
+				htree_convert_rect_geometry_to_absolute(&rect, frame, format);
+				htree_build_nodes_offsets_cache(frames, node->children, &rect, format);
+			} else {
+				htree_build_nodes_offsets_cache(frames, node->children, frame, format);
+			}
+		}
+	}
+}
+
+int htree_build_offsets_cache(HTDocument* doc)
+{
+	if (!doc) {
+		return HTREE_BAD_PARAMETER;
+	}
+	HTreeAllocatorScope scope(doc);
+	if (doc->offsets_cache) {
+		htree_drop_offsets_cache(doc);
+	}
+	HTreeOffsetsCache* cache = new (htree_alloc(sizeof(HTreeOffsetsCache))) HTreeOffsetsCache;
+	htree_document_top_rect(doc, &(cache->top));
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		htree_build_nodes_offsets_cache(cache->frames, tree->nodes, &(cache->top), doc->node_coord_format);
+	}
+	doc->offsets_cache = cache;
+	return HTREE_OK;
+}
+
+int htree_drop_offsets_cache(HTDocument* doc)
+{
+	if (!doc || !doc->offsets_cache) {
+		return HTREE_BAD_PARAMETER;
+	}
+	HTreeAllocatorScope scope(doc);
+	doc->offsets_cache->~HTreeOffsetsCache();
+	htree_free(doc->offsets_cache);
+	doc->offsets_cache = NULL;
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Memory usage
+ * ----------------------------------------------------------------------------- */
+
+/* the estimated size of the edges index array allocated by the power of two */
+static size_t htree_edges_index_memory(size_t count)
+{
+	size_t capacity = 1;
+	if (!count) {
+		return 0;
+	}
+	while (capacity < count) {
+		capacity *= 2;
+	}
+	return htree_alloc_block_size(sizeof(HTreeEdge*) * capacity);
+}
+
+static void htree_nodes_memory_usage(const HTreeNode* nodes, HTMemoryUsage* usage)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		usage->nodes += htree_alloc_block_size(sizeof(HTreeNode));
+		if (node->id) {
+			usage->strings += htree_alloc_block_size(node->id_len + 1);
+		}
+		if (node->point) {
+			usage->geometry += htree_alloc_block_size(sizeof(HTreePoint));
+		}
+		if (node->rect) {
+			usage->geometry += htree_alloc_block_size(sizeof(HTreeRect));
+		}
+		usage->indexes += htree_edges_index_memory(node->in_edges_count);
+		usage->indexes += htree_edges_index_memory(node->out_edges_count);
+		htree_nodes_memory_usage(node->children, usage);
+	}
+}
+
+static void htree_edges_memory_usage(const HTreeEdge* edges, HTMemoryUsage* usage)
+{
+	for (const HTreeEdge* edge = edges; edge; edge = edge->next) {
+		usage->edges += htree_alloc_block_size(sizeof(HTreeEdge));
+		if (edge->id) {
+			usage->strings += htree_alloc_block_size(edge->id_len + 1);
+		}
+		if (edge->source_id) {
+			usage->strings += htree_alloc_block_size(edge->source_id_len + 1);
+		}
+		if (edge->target_id) {
+			usage->strings += htree_alloc_block_size(edge->target_id_len + 1);
+		}
+		if (edge->source_point) {
+			usage->geometry += htree_alloc_block_size(sizeof(HTreePoint));
+		}
+		if (edge->target_point) {
+			usage->geometry += htree_alloc_block_size(sizeof(HTreePoint));
+		}
+		if (edge->label_point) {
+			usage->geometry += htree_alloc_block_size(sizeof(HTreePoint));
+		}
+		if (edge->label_rect) {
+			usage->geometry += htree_alloc_block_size(sizeof(HTreeRect));
+		}
+		for (const HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
+			usage->polylines += htree_alloc_block_size(sizeof(HTreePolyline));
+		}
+	}
+}
+
+/* the estimated hash table size: the buckets array & the nodes with the next pointer */
+static size_t htree_offsets_cache_memory(const HTreeOffsetsCache* cache)
+{
+	typedef HTreeOffsetsCacheMap::value_type Value;
+	return (htree_alloc_block_size(sizeof(HTreeOffsetsCache)) +
+			htree_alloc_block_size(sizeof(void*) * cache->frames.bucket_count()) +
+			cache->frames.size() * htree_alloc_block_size(sizeof(void*) + sizeof(Value)));
+}
+
+int htree_document_memory_usage(const HTDocument* doc, HTMemoryUsage* usage)
+{
+	if (!doc || !usage) {
+		return HTREE_BAD_PARAMETER;
+	}
+	memset(usage, 0, sizeof(HTMemoryUsage));
+
+	usage->other += htree_alloc_block_size(sizeof(HTDocument));
+	if (doc->bounding_rect) {
+		usage->geometry += htree_alloc_block_size(sizeof(HTreeRect));
+	}
+	if (doc->offsets_cache) {
+		usage->indexes += htree_offsets_cache_memory(doc->offsets_cache);
+	}
+	if (doc->pool) {
+		usage->other += htree_pool_memory(doc->pool, &(usage->pooled));
+	}
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		usage->other += htree_alloc_block_size(sizeof(HTree));
+		if (tree->nodes_index) {
+			usage->indexes += htree_alloc_block_size(sizeof(HTreeNode*) * tree->nodes_count);
+		}
+		htree_nodes_memory_usage(tree->nodes, usage);
+		htree_edges_memory_usage(tree->edges, usage);
+	}
+
+	usage->total = (usage->nodes + usage->edges + usage->geometry + usage->polylines +
+					usage->strings + usage->indexes + usage->other + usage->pooled);
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Geometry conversion into a separate document
+ * ----------------------------------------------------------------------------- */
+
+typedef HTreeMap<const HTreeNode*, HTreeNode*> HTreeNodesMap;
+
+static HTreeNode* htree_copy_nodes_to_absolute(const HTDocument* src_doc,
+											   const HTreeNode* src,
+											   HTreeNode* parent,
+											   const HTreeRect* frame,
+											   HTreeNodesMap& nodes_map)
+{
+	HTreeNode *result = NULL, *prev = NULL;
+	for (const HTreeNode* node = src; node; node = node->next) {
+		HTreeNode* dst = htree_new_node(node->type, node->id);
+		dst->parent = parent;
+		nodes_map[node] = dst;
+		if (node->point) {
+			dst->point = htree_copy_point(node->point);
+			htree_convert_point_geometry_to_absolute(dst->point, frame, src_doc->node_coord_format);
+		}
+		if (node->rect) {
+			dst->rect = htree_copy_rect(node->rect);
+			htree_convert_rect_geometry_to_absolute(dst->rect, frame, src_doc->node_coord_format);
+		}
+		if (node->children) {
+			dst->children = htree_copy_nodes_to_absolute(src_doc, node->children, dst,
+														 dst->rect ? dst->rect : frame,
+														 nodes_map);
+		}
+		if (prev) {
+			prev->next = dst;
+		} else {
+			result = dst;
+		}
+		prev = dst;
+	}
+	return result;
+}
+
+static HTreeNode* htree_copy_map_edge_node(const HTreeNode* node, const HTreeNodesMap& nodes_map)
+{
+	if (!node) {
+		return NULL;
+	}
+	auto i = nodes_map.find(node);
+	if (i == nodes_map.end()) {
+		return NULL;
+	}
+	return i->second;
+}
+
+static HTree* htree_copy_tree_to_absolute(const HTDocument* src_doc,
+										  const HTree* src,
+										  const HTreeRect* top)
+{
+	HTreeTraceScope trace("copy tree", src);
+	HTreeNodesMap nodes_map;
+	HTree* dst = htree_new_tree();
+	HTreeEdge* prev = NULL;
+	int abs_edges = (src_doc->edge_coord_format == coordAbsolute &&
+					 src_doc->edge_pl_coord_format == coordAbsolute);
+	
+	dst->nodes = htree_copy_nodes_to_absolute(src_doc, src->nodes, NULL, top, nodes_map);
+	
+	for (const HTreeEdge* edge = src->edges; edge; edge = edge->next) {
+		HTreeEdge* e = htree_copy_edge(edge);
+		htree_bind_edge(e,
+						htree_copy_map_edge_node(edge->source, nodes_map),
+						htree_copy_map_edge_node(edge->target, nodes_map));
+		if (prev) {
+			prev->next = e;
+		} else {
+			dst->edges = e;
+		}
+		prev = e;
+		if (e->source && (e->source->rect || e->source->point) &&
+			e->target && (e->target->rect || e->target->point)) {
+			if (!abs_edges) {
+				htree_convert_edge_geometry_to_absolute_points(e, e->source, e->target,
+															   src_doc->edge_coord_format,
+															   src_doc->edge_pl_coord_format);
+			}
+			if (src_doc->edge_format != edgeBorder) {
+				htree_convert_edge_geometry_to_absolute_borders(e, e->source, e->target);
+			}
+			htree_convert_edge_geometry_to_absolute_labels(e, e->source, src_doc);
+		} else if (!abs_edges) {
+			htree_drop_edge_geometry(e);
+		}
+	}
+	
+	return dst;
+}
+
+int htree_convert_document_geometry_copy(const HTDocument* src,
+										 HTDocument** dst,
+										 HTCoordFormat new_node_coord_format,
+										 HTCoordFormat new_edge_coord_format,
+										 HTCoordFormat new_edge_pl_coord_format,
+										 HTEdgeFormat new_edge_format)
+{
+	HTDocument* doc;
+	HTreeRect top;
+	HTree* prev = NULL;
+	
+	if (!src || !dst || src == *dst) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	/* the new document gets the source document allocator */
+	HTreeAllocatorScope scope(*dst ? *dst : src);
+	HTreeTraceScope trace("convert document copy", src);
+
+	if (*dst) {
+		/* reuse the destination document */
+		doc = *dst;
+		if (doc->trees) {
+			htree_destroy_tree(doc->trees);
+			doc->trees = NULL;
+		}
+		if (doc->offsets_cache) {
+			htree_drop_offsets_cache(doc);
+		}
+	} else {
+		doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	}
+	doc->node_coord_format = coordAbsolute;
+	doc->edge_coord_format = coordAbsolute;
+	doc->edge_pl_coord_format = coordAbsolute;
+	doc->edge_format = edgeBorder;
+
+	htree_document_top_rect(src, &top);
+	for (const HTree* tree = src->trees; tree && !htree_task_cancelled(); tree = tree->next) {
+		HTree* t = htree_copy_tree_to_absolute(src, tree, &top);
+		htree_task_tree_done(tree);
+		if (prev) {
+			prev->next = t;
+		} else {
+			doc->trees = t;
+		}
+		prev = t;
+	}
+	
+	htree_build_bounding_rect(doc, &(doc->bounding_rect));
+	htree_convert_document_geometry_to_format(doc,
+											  new_node_coord_format,
+											  new_edge_coord_format,
+											  new_edge_pl_coord_format,
+											  new_edge_format);
+	*dst = doc;
+	
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Subtree extraction
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+	const HTDocument*       doc;
+	double                  dx, dy;            /* the rebase offset */
+	HTreeRect               top;               /* the top-level frame of the extracted tree */
+	HTreeNodesMap           nodes_map;
+	HTreeVector<const HTreeNode*> sources;     /* the copied nodes having outgoing edges */
+} HTreeExtraction;
+
+static void htree_shift_point(HTreePoint* point, double dx, double dy)
+{
+	point->x += dx;
+	point->y += dy;
+}
+
+/* the nodes geometry relative to the parents outside of the subtree is recomputed
+   from the absolute one, framed nodes keep the relative geometry */
+static HTreeNode* htree_extract_nodes(HTreeExtraction& ex, const HTreeNode* src,
+									  HTreeNode* parent, bool framed, bool siblings)
+{
+	HTCoordFormat format = ex.doc->node_coord_format;
+	HTreeNode *result = NULL, *prev = NULL;
+	for (const HTreeNode* node = src; node; node = siblings ? node->next : NULL) {
+		HTreeNode* dst = htree_new_node(node->type, node->id);
+		dst->parent = parent;
+		ex.nodes_map[node] = dst;
+		if (node->out_edges_count > 0) {
+			ex.sources.push_back(node);
+		}
+		if (node->point) {
+			dst->point = htree_copy_point(node->point);
+			if (format == coordAbsolute) {
+				htree_shift_point(dst->point, ex.dx, ex.dy);
+			} else if (!framed && format != coordNone) {
+				htree_node_absolute_point(ex.doc, node, dst->point);
+				htree_shift_point(dst->point, ex.dx, ex.dy);
+				htree_convert_point_geometry_to_format(dst->point, &(ex.top), format);
+			}
+		}
+		if (node->rect) {
+			dst->rect = htree_copy_rect(node->rect);
+			if (format == coordAbsolute) {
+				dst->rect->x += ex.dx;
+				dst->rect->y += ex.dy;
+			} else if (!framed && format != coordNone) {
+				htree_node_absolute_rect(ex.doc, node, dst->rect);
+				dst->rect->x += ex.dx;
+				dst->rect->y += ex.dy;
+				htree_convert_rect_geometry_to_format(dst->rect, &(ex.top), format);
+			}
+		}
+		if (node->children) {
+			dst->children = htree_extract_nodes(ex, node->children, dst, framed || node->rect, true);
+		}
+		if (prev) {
+			prev->next = dst;
+		} else {
+			result = dst;
+		}
+		prev = dst;
+	}
+	return result;
+}
+
+/* the relative edge geometry follows the nodes, the absolute one is moved */
+static void htree_extract_edge_geometry(const HTreeExtraction& ex, HTreeEdge* edge)
+{
+	if (ex.doc->edge_coord_format == coordAbsolute) {
+		if (edge->source_point) htree_shift_point(edge->source_point, ex.dx, ex.dy);
+		if (edge->target_point) htree_shift_point(edge->target_point, ex.dx, ex.dy);
+		if (edge->label_point) htree_shift_point(edge->label_point, ex.dx, ex.dy);
+		if (edge->label_rect) {
+			edge->label_rect->x += ex.dx;
+			edge->label_rect->y += ex.dy;
+		}
+	}
+	if (ex.doc->edge_pl_coord_format == coordAbsolute) {
+		for (HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
+			htree_shift_point(&(pl->point), ex.dx, ex.dy);
+		}
+	}
+}
+
+static void htree_extract_edge(const HTreeExtraction& ex, HTree* tree, HTreeEdge*& prev,
+							   const HTreeEdge* edge, HTreeNode* source, HTreeNode* target)
+{
+	HTreeEdge* e = htree_copy_edge(edge);
+	htree_extract_edge_geometry(ex, e);
+	htree_bind_edge(e, source, target);
+	if (prev) {
+		prev->next = e;
+	} else {
+		tree->edges = e;
+	}
+	prev = e;
+}
+
+static const HTree* htree_node_tree(const HTDocument* doc, const HTreeNode* node)
+{
+	while (node->parent) {
+		node = node->parent;
+	}
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		for (const HTreeNode* n = tree->nodes; n; n = n->next) {
+			if (n == node) {
+				return tree;
+			}
+		}
+	}
+	return NULL;
+}
+
+typedef HTreeMap<std::string_view, const HTreeNode*> HTreeExtractionIndex;
+
+/* the first node having the id is taken as htree_build_adjacency does */
+static void htree_extract_index_nodes(const HTreeNode* nodes, HTreeExtractionIndex& index)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		if (node->id) {
+			index.insert(std::make_pair(std::string_view(node->id, node->id_len), node));
+		}
+		htree_extract_index_nodes(node->children, index);
+	}
+}
+
+static HTreeNode* htree_extract_end_node(const HTreeExtraction& ex, const HTreeExtractionIndex& index,
+										 const HTreeNode* node, const char* id, size_t id_len)
+{
+	if (!node && id) {
+		auto i = index.find(std::string_view(id, id_len));
+		if (i != index.end()) {
+			node = i->second;
+		}
+	}
+	return htree_copy_map_edge_node(node, ex.nodes_map);
+}
+
+int htree_extract_subtree(const HTDocument* doc, const HTreeNode* root, int rebase, HTree** result)
+{
+	if (!doc || !root || !result) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	HTreeAllocatorScope scope(doc);
+	HTreeTraceScope trace("extract subtree", doc);
+	HTreeExtraction ex;
+	ex.doc = doc;
+	ex.dx = ex.dy = 0.0;
+	htree_init_rect(&(ex.top));
+	if (rebase) {
+		HTreeRect rect;
+		HTreePoint point;
+		if (root->rect && htree_node_absolute_rect(doc, root, &rect) == HTREE_OK) {
+			ex.dx = -rect.x;
+			ex.dy = -rect.y;
+		} else if (root->point && htree_node_absolute_point(doc, root, &point) == HTREE_OK) {
+			ex.dx = -point.x;
+			ex.dy = -point.y;
+		}
+	}
+
+	HTree* tree = htree_new_tree();
+	tree->nodes = htree_extract_nodes(ex, root, NULL, false, false);
+
+	/* the internal edges are found by the adjacency index of the nodes */
+	HTreeEdge* prev = NULL;
+	for (const HTreeNode* node: ex.sources) {
+		HTreeNode* source = ex.nodes_map[node];
+		for (size_t i = 0; i < node->out_edges_count; i++) {
+			const HTreeEdge* edge = node->out_edges[i];
+			HTreeNode* target = htree_copy_map_edge_node(edge->target, ex.nodes_map);
+			if (target) {
+				htree_extract_edge(ex, tree, prev, edge, source, target);
+			}
+		}
+	}
+
+	/* the edges not bound yet are not indexed, their ends are resolved by the ids
+	   within the root tree */
+	const HTree* root_tree = htree_node_tree(doc, root);
+	HTreeExtractionIndex index;
+	for (const HTreeEdge* edge = root_tree ? root_tree->edges : NULL; edge; edge = edge->next) {
+		if (edge->source && edge->target) {
+			continue;
+		}
+		if (index.empty()) {
+			htree_extract_index_nodes(root_tree->nodes, index);
+		}
+		HTreeNode* source = htree_extract_end_node(ex, index, edge->source, edge->source_id, edge->source_id_len);
+		HTreeNode* target = htree_extract_end_node(ex, index, edge->target, edge->target_id, edge->target_id_len);
+		if (source && target) {
+			htree_extract_edge(ex, tree, prev, edge, source, target);
+		}
+	}
+
+	*result = tree;
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Documents merge
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+	HTreeSet<std::string_view>         ids;
+	HTreeMap<std::string_view, size_t> suffixes;   /* the last suffix of the renamed ids */
+} HTreeMergeIds;
+
+static size_t htree_merge_nodes_conflicts(const HTreeNode* nodes, const HTreeMergeIds& ids)
+{
+	size_t count = 0;
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		if (node->id && ids.ids.count(std::string_view(node->id, node->id_len))) {
+			count++;
+		}
+		count += htree_merge_nodes_conflicts(node->children, ids);
+	}
+	return count;
+}
+
+static size_t htree_merge_conflicts(const HTree* trees, const HTreeMergeIds& nodes_ids,
+									const HTreeMergeIds& edges_ids)
+{
+	size_t count = 0;
+	for (const HTree* tree = trees; tree; tree = tree->next) {
+		count += htree_merge_nodes_conflicts(tree->nodes, nodes_ids);
+		for (const HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+			if (edge->id && edges_ids.ids.count(std::string_view(edge->id, edge->id_len))) {
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+/* the ids of the document, the sources are checked against them */
+static void htree_merge_collect_nodes_ids(const HTreeNode* nodes, HTreeMergeIds& ids)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		if (node->id) {
+			ids.ids.insert(std::string_view(node->id, node->id_len));
+		}
+		htree_merge_collect_nodes_ids(node->children, ids);
+	}
+}
+
+static void htree_merge_collect_ids(const HTree* trees, HTreeMergeIds& nodes_ids, HTreeMergeIds& edges_ids)
+{
+	for (const HTree* tree = trees; tree; tree = tree->next) {
+		htree_merge_collect_nodes_ids(tree->nodes, nodes_ids);
+		for (const HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+			if (edge->id) {
+				edges_ids.ids.insert(std::string_view(edge->id, edge->id_len));
+			}
+		}
+	}
+}
+
+/* the colliding id gets the first free numeric suffix, the new id is unique among both the
+   document and the source ids; the old string is kept by the caller */
+static void htree_merge_rename(HTreeMergeIds& ids, HTreeSet<std::string_view>& source_ids,
+							   char** id, size_t* id_len)
+{
+	std::string_view base = *(ids.ids.find(std::string_view(*id, *id_len)));
+	size_t& suffix = ids.suffixes[base];
+	HTreeVector<char> buffer(base.size() + 24);
+	do {
+		snprintf(buffer.data(), buffer.size(), "%.*s-%zu", (int)base.size(), base.data(), ++suffix);
+	} while (ids.ids.count(std::string_view(buffer.data())) ||
+			 source_ids.count(std::string_view(buffer.data())));
+	htree_copy_string(id, id_len, buffer.data());
+	source_ids.insert(std::string_view(*id, *id_len));
+}
+
+typedef HTreeMap<std::string_view, HTreeNode*> HTreeRenamedNodes;
+
+static void htree_merge_nodes_ids(HTreeNode* nodes, HTreeMergeIds& ids, HTreeSet<std::string_view>& source_ids,
+								  bool rename, HTreeRenamedNodes& renamed, HTreeVector<char*>& old_ids,
+								  size_t& found)
+{
+	for (HTreeNode* node = nodes; node; node = node->next) {
+		if (node->id && ids.ids.count(std::string_view(node->id, node->id_len))) {
+			found++;
+			if (rename) {
+				old_ids.push_back(node->id);
+				htree_merge_rename(ids, source_ids, &(node->id), &(node->id_len));
+				renamed.insert(std::make_pair(std::string_view(old_ids.back()), node));
+			}
+		}
+		htree_merge_nodes_ids(node->children, ids, source_ids, rename, renamed, old_ids, found);
+	}
+}
+
+/* the edge ends referencing the renamed node get the new id: the bound end takes the id
+   of its node, the one not bound yet the id of the first node renamed from its id */
+static void htree_merge_edge_end(char** id, size_t* id_len, const HTreeNode* node,
+								 const HTreeRenamedNodes& renamed)
+{
+	if (!*id) {
+		return ;
+	}
+	auto i = renamed.find(std::string_view(*id, *id_len));
+	if (i == renamed.end()) {
+		return ;
+	}
+	if (!node) {
+		node = i->second;
+	}
+	if (node->id && std::string_view(node->id, node->id_len) != std::string_view(*id, *id_len)) {
+		htree_free(*id);
+		htree_copy_string(id, id_len, node->id);
+	}
+}
+
+/* the ids are unique within the whole document: the source ids existing in the document
+   are the conflicts, the source joins the document ids after the check, so the ids
+   repeated within the source itself are not counted */
+static void htree_merge_ids(HTree* trees, HTreeMergeIds& nodes_ids, HTreeMergeIds& edges_ids,
+							bool rename, size_t& found)
+{
+	HTreeMergeIds source_nodes, source_edges;
+	htree_merge_collect_ids(trees, source_nodes, source_edges);
+	HTreeVector<char*> old_ids;
+	/* the edges may reference the nodes of the other trees of the source */
+	HTreeRenamedNodes renamed;
+	for (HTree* tree = trees; tree; tree = tree->next) {
+		htree_merge_nodes_ids(tree->nodes, nodes_ids, source_nodes.ids, rename, renamed, old_ids, found);
+	}
+	for (HTree* tree = trees; tree; tree = tree->next) {
+		for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+			if (edge->id && edges_ids.ids.count(std::string_view(edge->id, edge->id_len))) {
+				found++;
+				if (rename) {
+					old_ids.push_back(edge->id);
+					htree_merge_rename(edges_ids, source_edges.ids, &(edge->id), &(edge->id_len));
+				}
+			}
+			if (!renamed.empty()) {
+				htree_merge_edge_end(&(edge->source_id), &(edge->source_id_len), edge->source, renamed);
+				htree_merge_edge_end(&(edge->target_id), &(edge->target_id_len), edge->target, renamed);
+			}
+		}
+	}
+	htree_merge_collect_ids(trees, nodes_ids, edges_ids);
+	for (char* id: old_ids) {
+		htree_free(id);
+	}
+}
+
+static bool htree_same_allocator(const HTAllocator& a, const HTAllocator& b)
+{
+	if (!a.alloc || !b.alloc) {
+		return !a.alloc && !b.alloc;
+	}
+	return a.alloc == b.alloc && a.free == b.free && a.context == b.context;
+}
+
+/* the merge goes in the absolute coordinates: the top level of the relative formats
+   depends on the bounding rect of the whole document */
+static HTCoordFormat htree_merge_format(HTCoordFormat format)
+{
+	return format == coordNone ? coordNone : coordAbsolute;
+}
+
+/* take the trees of the source document in the destination formats; the trees are
+   converted in a copy made by the destination allocator, so the source is left as is
+   until everything succeeds */
+static int htree_merge_take_trees(HTDocument* dst, HTDocument* src, HTree** trees)
+{
+	bool convert = (src->node_coord_format != dst->node_coord_format ||
+					src->edge_coord_format != dst->edge_coord_format ||
+					src->edge_pl_coord_format != dst->edge_pl_coord_format ||
+					src->edge_format != dst->edge_format);
+	if (!convert && htree_same_allocator(src->allocator, dst->allocator)) {
+		*trees = src->trees;
+	} else {
+		HTDocument* copy;
+		{
+			/* the objects should be freed by the allocator of the owner document */
+			HTreeAllocatorScope scope(dst);
+			copy = htree_new_document(src->node_coord_format,
+									  src->edge_coord_format,
+									  src->edge_pl_coord_format,
+									  src->edge_format);
+			copy->trees = htree_copy_tree(src->trees);
+			if (src->bounding_rect) {
+				copy->bounding_rect = htree_copy_rect(src->bounding_rect);
+			}
+		}
+		int res = copy->trees ? HTREE_OK : HTREE_NOT_FOUND;
+		if (res == HTREE_OK && convert) {
+			res = htree_convert_document_geometry(copy,
+												  dst->node_coord_format,
+												  dst->edge_coord_format,
+												  dst->edge_pl_coord_format,
+												  dst->edge_format);
+		}
+		if (res == HTREE_OK) {
+			*trees = copy->trees;
+			copy->trees = NULL;
+		}
+		htree_destroy_document(copy);
+		if (res != HTREE_OK) {
+			return res;
+		}
+		HTreeAllocatorScope scope(src);
+		htree_destroy_tree(src->trees);
+	}
+	if (src->offsets_cache) {
+		htree_drop_offsets_cache(src);
+	}
+	src->trees = NULL;
+	return HTREE_OK;
+}
+
+int htree_merge_documents(HTDocument* dst, HTDocument** srcs, size_t count,
+						  HTMergePolicy policy, size_t* conflicts)
+{
+	if (!dst || (!srcs && count > 0)) {
+		return HTREE_BAD_PARAMETER;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (!srcs[i] || srcs[i] == dst) {
+			return HTREE_BAD_PARAMETER;
+		}
+	}
+
+	HTreeTraceScope trace("merge documents", dst);
+	HTreeMergeIds nodes_ids, edges_ids;
+	size_t found = 0;
+	htree_merge_collect_ids(dst->trees, nodes_ids, edges_ids);
+
+	if (policy == mergeFail) {
+		/* the sources are checked against each other before anything is moved */
+		for (size_t i = 0; i < count; i++) {
+			found += htree_merge_conflicts(srcs[i]->trees, nodes_ids, edges_ids);
+			htree_merge_collect_ids(srcs[i]->trees, nodes_ids, edges_ids);
+		}
+		if (conflicts) {
+			*conflicts = found;
+		}
+		if (found) {
+			return HTREE_ID_CONFLICT;
+		}
+	}
+
+	int cached = dst->offsets_cache != NULL;
+	if (cached) {
+		htree_drop_offsets_cache(dst);
+	}
+	HTCoordFormat node_coord_format = dst->node_coord_format;
+	HTCoordFormat edge_coord_format = dst->edge_coord_format;
+	HTCoordFormat edge_pl_coord_format = dst->edge_pl_coord_format;
+	bool absolute = (node_coord_format == htree_merge_format(node_coord_format) &&
+					 edge_coord_format == htree_merge_format(edge_coord_format) &&
+					 edge_pl_coord_format == htree_merge_format(edge_pl_coord_format));
+	bool merged = false;
+	HTree* tail = dst->trees;
+	while (tail && tail->next) {
+		tail = tail->next;
+	}
+
+	int res = HTREE_OK;
+	for (size_t i = 0; i < count && res == HTREE_OK; i++) {
+		HTDocument* src = srcs[i];
+		HTree* trees = NULL;
+		if (!src->trees) {
+			continue;
+		}
+		if (policy == mergeSkipDocument) {
+			size_t n = htree_merge_conflicts(src->trees, nodes_ids, edges_ids);
+			if (n) {
+				found += n;
+				continue;
+			}
+		}
+		if (!merged && !absolute) {
+			res = htree_convert_document_geometry(dst,
+												  htree_merge_format(node_coord_format),
+												  htree_merge_format(edge_coord_format),
+												  htree_merge_format(edge_pl_coord_format),
+												  dst->edge_format);
+			if (res != HTREE_OK) {
+				break;
+			}
+		}
+		merged = true;
+		res = htree_merge_take_trees(dst, src, &trees);
+		if (res != HTREE_OK) {
+			break;
+		}
+		{
+			HTreeAllocatorScope scope(dst);
+			if (policy == mergeSkipDocument) {
+				htree_merge_collect_ids(trees, nodes_ids, edges_ids);
+			} else if (policy != mergeFail) {
+				htree_merge_ids(trees, nodes_ids, edges_ids, policy == mergeRenameIds, found);
+			}
+		}
+		if (tail) {
+			tail->next = trees;
+		} else {
+			dst->trees = trees;
+		}
+		for (tail = trees; tail->next; tail = tail->next);
+	}
+
+	/* the bounding rect is rebuilt over all the trees, the document gets its formats back */
+	if (merged && !absolute) {
+		int converted = htree_convert_document_geometry(dst, node_coord_format, edge_coord_format,
+														edge_pl_coord_format, dst->edge_format);
+		if (res == HTREE_OK) {
+			res = converted;
+		}
+	} else if (merged) {
+		htree_build_bounding_rect(dst, &(dst->bounding_rect));
+	}
+	if (cached) {
+		htree_build_offsets_cache(dst);
+	}
+	if (conflicts) {
+		*conflicts = found;
+	}
+	return res;
+}
+
+/* -----------------------------------------------------------------------------
+ * Edge polylines simplification
+ * ----------------------------------------------------------------------------- */
+
+static double htree_point_segment_distance(const HTreePoint* p,
+										   const HTreePoint* a,
+										   const HTreePoint* b)
+{
+	double dx = b->x - a->x;
+	double dy = b->y - a->y;
+	double len2 = dx * dx + dy * dy;
+	double t = 0.0;
+	if (len2 > 0.0) {
+		t = ((p->x - a->x) * dx + (p->y - a->y) * dy) / len2;
+		if (t < 0.0) t = 0.0;
+		if (t > 1.0) t = 1.0;
+	}
+	double px = a->x + t * dx - p->x;
+	double py = a->y + t * dy - p->y;
+	return sqrt(px * px + py * py);
+}
+
+/* Douglas-Peucker over the points [first, last], both ends are always kept */
+static void htree_simplify_points(const HTreeVector<const HTreePoint*>& points,
+								  HTreeVector<char>& keep,
+								  double tolerance)
+{
+	HTreeVector<std::pair<size_t, size_t> > stack;
+	stack.push_back(std::make_pair((size_t)0, points.size() - 1));
+	while (!stack.empty()) {
+		size_t first = stack.back().first;
+		size_t last = stack.back().second;
+		stack.pop_back();
+		if (last <= first + 1) continue;
+		double max_dist = -1.0;
+		size_t index = first;
+		for (size_t i = first + 1; i < last; i++) {
+			double d = htree_point_segment_distance(points[i], points[first], points[last]);
+			if (d > max_dist) {
+				max_dist = d;
+				index = i;
+			}
+		}
+		if (max_dist > tolerance) {
+			keep[index] = 1;
+			stack.push_back(std::make_pair(first, index));
+			stack.push_back(std::make_pair(index, last));
+		}
+	}
+}
+
+static int htree_simplify_edge_polyline(HTreeEdge* edge, double tolerance, int use_edge_points)
+{
+	HTreeVector<const HTreePoint*> points;
+	HTreeVector<HTreePolyline*> links;
+	HTreeVector<char> keep;
+	size_t offset = 0;
+
+	if (!edge || !edge->polyline) {
+		return HTREE_OK;
+	}
+
+	if (use_edge_points) {
+		points.push_back(edge->source_point);
+		offset = 1;
+	}
+	for (HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
+		points.push_back(&(pl->point));
+		links.push_back(pl);
+	}
+	if (use_edge_points) {
+		points.push_back(edge->target_point);
+	}
+	if (points.size() < 3) {
+		return HTREE_OK;
+	}
+
+	keep.assign(points.size(), 0);
+	keep.front() = keep.back() = 1;
+	htree_simplify_points(points, keep, tolerance);
+
+	HTreePolyline *head = NULL, *prev = NULL;
+	for (size_t i = 0; i < links.size(); i++) {
+		HTreePolyline* pl = links[i];
+		if (keep[i + offset]) {
+			if (prev) {
+				prev->next = pl;
+			} else {
+				head = pl;
+			}
+			prev = pl;
+		} else {
+			pl->next = NULL;
+			htree_destroy_polyline(pl);
+		}
+	}
+	if (prev) {
+		prev->next = NULL;
+	}
+	edge->polyline = head;
+	
+	return HTREE_OK;
+}
+
+static void htree_simplify_tree_polylines(HTree* tree, double tolerance, int use_edge_points)
+{
+	HTreeTraceScope trace("simplify tree", tree);
+	for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+		htree_simplify_edge_polyline(edge,
+									 tolerance,
+									 use_edge_points && edge->source_point && edge->target_point);
+	}
+}
+
+int htree_simplify_document_polylines(HTDocument* doc, double tolerance, unsigned int threads)
+{
+	if (!doc || tolerance < 0.0) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	/* the source & target points can be used as the chain ends only if they are
+	   in the same coordinate system as the polyline points */
+	int use_edge_points = (doc->edge_coord_format == coordAbsolute &&
+						   doc->edge_pl_coord_format == coordAbsolute);
+	
+	HTreeAllocatorScope scope(doc);
+	HTreeVector<HTree*> trees;
+	for (HTree* tree = doc->trees; tree; tree = tree->next) {
+		trees.push_back(tree);
+	}
+
+	htree_parallel_for(trees.size(), threads, [&](size_t i) {
+		HTreeAllocatorScope worker_scope(doc);
+		htree_simplify_tree_polylines(trees[i], tolerance, use_edge_points);
+	});
+	
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Viewport culling & level of details
+ * ----------------------------------------------------------------------------- */
+
+static int htree_rect_intersects_viewport(const HTreeRect* rect, const HTreeRect* viewport)
+{
+	return (rect->x <= viewport->x + viewport->width &&
+			rect->x + rect->width >= viewport->x &&
+			rect->y <= viewport->y + viewport->height &&
+			rect->y + rect->height >= viewport->y);
+}
+
+static int htree_point_in_viewport(const HTreePoint* point, const HTreeRect* viewport)
+{
+	return (point->x >= viewport->x && point->x <= viewport->x + viewport->width &&
+			point->y >= viewport->y && point->y <= viewport->y + viewport->height);
+}
+
+/* the composite node is collapsed if its area on the screen is below the size squared */
+static void htree_query_viewport_nodes(const HTDocument* doc,
+									   const HTreeNode* nodes,
+									   const HTreeRect* viewport,
+									   double zoom,
+									   double min_composite_size,
+									   HTreeVector<HTreeNode*>& visible,
+									   HTreeVector<HTreeNode*>& collapsed)
+{
+	HTreeRect rect;
+	HTreePoint point;
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		if (node->rect) {
+			htree_node_absolute_rect(doc, node, &rect);
+			if (!htree_rect_intersects_viewport(&rect, viewport)) {
+				/* the children are placed inside the parent's rect */
+				continue;
+			}
+			if (node->children &&
+				rect.width * rect.height * zoom * zoom < min_composite_size * min_composite_size) {
+				collapsed.push_back((HTreeNode*)node);
+				continue;
+			}
+			visible.push_back((HTreeNode*)node);
+		} else if (node->point) {
+			htree_node_absolute_point(doc, node, &point);
+			if (htree_point_in_viewport(&point, viewport)) {
+				visible.push_back((HTreeNode*)node);
+			}
+		}
+		if (node->children) {
+			htree_query_viewport_nodes(doc, node->children, viewport, zoom, min_composite_size,
+									   visible, collapsed);
+		}
+	}
+}
+
+static const HTreeNode* htree_viewport_node_representative(const HTreeNode* node,
+														   const HTreeSet<const HTreeNode*>& collapsed)
+{
+	const HTreeNode* result = node;
+	if (!node || collapsed.empty()) {
+		return result;
+	}
+	for (const HTreeNode* n = node; n; n = n->parent) {
+		if (collapsed.count(n)) {
+			result = n;
+		}
+	}
+	return result;
+}
+
+static void htree_extend_bounds(double& x1, double& y1, double& x2, double& y2, int& empty,
+								double x, double y)
+{
+	if (empty) {
+		x1 = x2 = x;
+		y1 = y2 = y;
+		empty = 0;
+		return ;
+	}
+	if (x < x1) x1 = x;
+	if (x > x2) x2 = x;
+	if (y < y1) y1 = y;
+	if (y > y2) y2 = y;
+}
+
+static int htree_edge_in_viewport(const HTDocument* doc, const HTreeEdge* edge, const HTreeRect* viewport)
+{
+	double x1 = 0.0, y1 = 0.0, x2 = 0.0, y2 = 0.0;
+	int empty = 1;
+	HTreePoint source, target;
+	HTreePolyline* polyline = NULL;
+
+	if (htree_edge_absolute_points(doc, edge, &source, &target, &polyline) == HTREE_OK) {
+		htree_extend_bounds(x1, y1, x2, y2, empty, source.x, source.y);
+		htree_extend_bounds(x1, y1, x2, y2, empty, target.x, target.y);
+		for (const HTreePolyline* pl = polyline; pl; pl = pl->next) {
+			htree_extend_bounds(x1, y1, x2, y2, empty, pl->point.x, pl->point.y);
+		}
+		if (polyline) {
+			htree_destroy_polyline(polyline);
+		}
+	} else if (doc->edge_coord_format == coordAbsolute && doc->edge_pl_coord_format == coordAbsolute) {
+		/* the unbound edge is drawn by its own points */
+		if (edge->source_point) {
+			htree_extend_bounds(x1, y1, x2, y2, empty, edge->source_point->x, edge->source_point->y);
+		}
+		if (edge->target_point) {
+			htree_extend_bounds(x1, y1, x2, y2, empty, edge->target_point->x, edge->target_point->y);
+		}
+		for (const HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
+			htree_extend_bounds(x1, y1, x2, y2, empty, pl->point.x, pl->point.y);
+		}
+	}
+	if (empty) {
+		return 0;
+	}
+
+	HTreeRect bounds;
+	bounds.x = x1;
+	bounds.y = y1;
+	bounds.width = x2 - x1;
+	bounds.height = y2 - y1;
+	return htree_rect_intersects_viewport(&bounds, viewport);
+}
+
+template<class T>
+static T** htree_vector_to_array(const HTreeVector<T*>& v, size_t* count)
+{
+	*count = v.size();
+	if (v.empty()) {
+		return NULL;
+	}
+	T** array = (T**)htree_alloc(sizeof(T*) * v.size());
+	memcpy(array, v.data(), sizeof(T*) * v.size());
+	return array;
+}
+
+int htree_query_viewport(const HTDocument* doc,
+						 const HTreeRect* viewport,
+						 double zoom,
+						 double min_composite_size,
+						 HTViewport** result)
+{
+	if (!doc || !viewport || !result || zoom <= 0.0) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	HTreeVector<HTreeNode*> visible;
+	HTreeVector<HTreeNode*> collapsed;
+	HTreeVector<HTreeEdge*> edges;
+
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		htree_query_viewport_nodes(doc, tree->nodes, viewport, zoom, min_composite_size,
+								   visible, collapsed);
+	}
+
+	HTreeSet<const HTreeNode*> collapsed_set(collapsed.begin(), collapsed.end());
+
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+			const HTreeNode* source = htree_viewport_node_representative(edge->source, collapsed_set);
+			const HTreeNode* target = htree_viewport_node_representative(edge->target, collapsed_set);
+			if (source && source != edge->source && source == target) {
+				/* the edge is hidden inside a collapsed composite node */
+				continue;
+			}
+			if (htree_edge_in_viewport(doc, edge, viewport)) {
+				edges.push_back(edge);
+			}
+		}
+	}
+
+	HTViewport* v = (HTViewport*)htree_alloc(sizeof(HTViewport));
+	memset(v, 0, sizeof(HTViewport));
+	v->nodes = htree_vector_to_array(visible, &(v->nodes_count));
+	v->collapsed_nodes = htree_vector_to_array(collapsed, &(v->collapsed_nodes_count));
+	v->edges = htree_vector_to_array(edges, &(v->edges_count));
+	*result = v;
+	
+	return HTREE_OK;
+}
+
+int htree_destroy_viewport(HTViewport* viewport)
+{
+	if (!viewport) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (viewport->nodes) htree_free(viewport->nodes);
+	if (viewport->collapsed_nodes) htree_free(viewport->collapsed_nodes);
+	if (viewport->edges) htree_free(viewport->edges);
+	htree_free(viewport);
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Document validation
+ * ----------------------------------------------------------------------------- */
+
+typedef HTreeMap<std::string_view, const HTreeNode*> HTreeValidationIndex;
+
+static const char* issue_type_names[issueTypesCount] = {
+	"duplicate node id",
+	"duplicate edge id",
+	"dangling edge",
+	"unbound edge",
+	"missing node geometry",
+	"missing endpoint geometry",
+	"format mismatch"
+};
+
+const char* htree_issue_type_name(HTIssueType type)
+{
+	if (type < 0 || type >= issueTypesCount) {
+		return NULL;
+	}
+	return issue_type_names[type];
+}
+
+static void htree_add_issue(HTreeVector<HTIssue>& issues, HTIssueType type, const HTree* tree,
+							const HTreeNode* node, const HTreeEdge* edge, const char* id)
+{
+	HTIssue issue = {type, tree, node, edge, id};
+	issues.push_back(issue);
+}
+
+static bool htree_validate_node_geometry(const HTreeNode* node)
+{
+	return node->type == htPoint ? node->point != NULL : node->rect != NULL;
+}
+
+/* the ids are unique in the document, the edge ends are resolved within the tree */
+static void htree_validate_nodes(const HTDocument* doc, const HTree* tree, const HTreeNode* nodes,
+								 HTreeValidationIndex& index, HTreeSet<std::string_view>& ids,
+								 HTreeVector<HTIssue>& issues)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		if (node->id) {
+			std::string_view id(node->id, node->id_len);
+			index.insert(std::make_pair(id, node));
+			if (!ids.insert(id).second) {
+				htree_add_issue(issues, issueDuplicateNodeId, tree, node, NULL, node->id);
+			}
+		}
+		if (doc->node_coord_format == coordNone) {
+			if (node->rect || node->point) {
+				htree_add_issue(issues, issueFormatMismatch, tree, node, NULL, node->id);
+			}
+		} else if (!htree_validate_node_geometry(node)) {
+			htree_add_issue(issues, issueMissingNodeGeometry, tree, node, NULL, node->id);
+		}
+		htree_validate_nodes(doc, tree, node->children, index, ids, issues);
+	}
+}
+
+static void htree_validate_edge_end(const HTree* tree, const HTreeEdge* edge,
+									const char* id, size_t id_len, const HTreeNode* bound,
+									const HTreeValidationIndex& index, HTreeVector<HTIssue>& issues)
+{
+	auto i = id ? index.find(std::string_view(id, id_len)) : index.end();
+	if (i == index.end()) {
+		htree_add_issue(issues, issueDanglingEdge, tree, NULL, edge, id);
+		return;
+	}
+	/* the end not bound yet is resolved by the id, the end bound to a duplicated id
+	   is not the indexed node but is still right */
+	const HTreeNode* node = bound ? bound : i->second;
+	if (bound && (!bound->id || std::string_view(bound->id, bound->id_len) != std::string_view(id, id_len))) {
+		htree_add_issue(issues, issueUnboundEdge, tree, NULL, edge, id);
+	} else if (!node->rect && !node->point &&
+			   (edge->source_point || edge->target_point || edge->polyline ||
+				edge->label_point || edge->label_rect)) {
+		/* the edge geometry is dropped by the conversion */
+		htree_add_issue(issues, issueMissingEndpointGeometry, tree, node, edge, id);
+	}
+}
+
+int htree_validate_document(const HTDocument* doc, HTValidation** result)
+{
+	if (!doc || !result) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	HTreeVector<HTIssue> issues;
+	HTreeSet<std::string_view> nodes_ids, edges_ids;
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		HTreeValidationIndex nodes_index;
+		htree_validate_nodes(doc, tree, tree->nodes, nodes_index, nodes_ids, issues);
+		for (const HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+			if (edge->id && !edges_ids.insert(std::string_view(edge->id, edge->id_len)).second) {
+				htree_add_issue(issues, issueDuplicateEdgeId, tree, NULL, edge, edge->id);
+			}
+			htree_validate_edge_end(tree, edge, edge->source_id, edge->source_id_len, edge->source,
+									nodes_index, issues);
+			htree_validate_edge_end(tree, edge, edge->target_id, edge->target_id_len, edge->target,
+									nodes_index, issues);
+			if (((edge->source_point || edge->target_point || edge->label_point || edge->label_rect) &&
+				 (doc->edge_coord_format == coordNone || doc->edge_format == edgeNone)) ||
+				(edge->polyline && doc->edge_pl_coord_format == coordNone)) {
+				htree_add_issue(issues, issueFormatMismatch, tree, NULL, edge, edge->id);
+			}
+		}
+	}
+
+	HTValidation* v = (HTValidation*)htree_alloc(sizeof(HTValidation));
+	v->issues_count = issues.size();
+	v->issues = NULL;
+	if (!issues.empty()) {
+		v->issues = (HTIssue*)htree_alloc(sizeof(HTIssue) * issues.size());
+		memcpy(v->issues, issues.data(), sizeof(HTIssue) * issues.size());
+	}
+	*result = v;
+	
+	return HTREE_OK;
+}
+
+int htree_destroy_validation(HTValidation* validation)
+{
+	if (!validation) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (validation->issues) htree_free(validation->issues);
+	htree_free(validation);
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Overlaps detection: sweep line over the absolute rects
+ * ----------------------------------------------------------------------------- */
+
+typedef std::pair<size_t, size_t> HTreeIndexPair;
+
+/* the active boxes on the sweep line: the max-tree over the boxes sorted by the lower
+   cross coordinate, the leaf keeps the upper cross coordinate of the active box; the
+   boxes crossing an interval are found by the descent into the subtrees with the large
+   enough maximum */
+class HTreeActiveIntervals {
+public:
+	explicit HTreeActiveIntervals(size_t count): size(1)
+	{
+		while (size < count) {
+			size <<= 1;
+		}
+		max.assign(2 * size, std::numeric_limits<double>::lowest());
+	}
+
+	void set(size_t rank, double value)
+	{
+		size_t i = rank + size;
+		max[i] = value;
+		for (i >>= 1; i > 0; i >>= 1) {
+			max[i] = std::max(max[2 * i], max[2 * i + 1]);
+		}
+	}
+
+	void reset(size_t rank)
+	{
+		set(rank, std::numeric_limits<double>::lowest());
+	}
+
+	/* reports the ranks below end with the value above bound */
+	template <typename F>
+	void query(size_t end, double bound, F report) const
+	{
+		query(1, 0, size, end, bound, report);
+	}
+
+private:
+	template <typename F>
+	void query(size_t node, size_t from, size_t to, size_t end, double bound, F& report) const
+	{
+		if (from >= end || max[node] <= bound) {
+			return ;
+		}
+		if (to - from == 1) {
+			report(from);
+			return ;
+		}
+		size_t middle = (from + to) / 2;
+		query(2 * node, from, middle, end, bound, report);
+		query(2 * node + 1, middle, to, end, bound, report);
+	}
+
+	size_t                                   size;
+	HTreeVector<double>                      max;
+};
+
+/* the pairs (i < j) of the boxes with the intersecting interiors, the touching boxes do
+   not overlap; the sweep goes along the axis where the boxes are less crowded */
+static void htree_sweep_overlaps(const HTreeVector<HTreeBox>& boxes, HTreeVector<HTreeIndexPair>& pairs)
+{
+	if (boxes.size() < 2) {
+		return ;
+	}
+	HTreeBox bounds = htree_core_box();
+	double widths = 0.0, heights = 0.0;
+	for (const HTreeBox& b: boxes) {
+		htree_core_box_add(bounds, b);
+		widths += b.x2 - b.x1;
+		heights += b.y2 - b.y1;
+	}
+	bool sweep_x = (widths * (bounds.y2 - bounds.y1) <= heights * (bounds.x2 - bounds.x1));
+	auto lo = [sweep_x](const HTreeBox& b) { return sweep_x ? b.x1 : b.y1; };
+	auto hi = [sweep_x](const HTreeBox& b) { return sweep_x ? b.x2 : b.y2; };
+	auto cross_lo = [sweep_x](const HTreeBox& b) { return sweep_x ? b.y1 : b.x1; };
+	auto cross_hi = [sweep_x](const HTreeBox& b) { return sweep_x ? b.y2 : b.x2; };
+
+	HTreeVector<size_t> order(boxes.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	HTreeVector<size_t> by_rank(order);
+	/* the empty boxes go first, so they expire before the boxes starting at the same point */
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		if (lo(boxes[a]) != lo(boxes[b])) {
+			return lo(boxes[a]) < lo(boxes[b]);
+		}
+		return hi(boxes[a]) < hi(boxes[b]) || (hi(boxes[a]) == hi(boxes[b]) && a < b);
+	});
+	std::sort(by_rank.begin(), by_rank.end(), [&](size_t a, size_t b) {
+		return cross_lo(boxes[a]) < cross_lo(boxes[b]) || (cross_lo(boxes[a]) == cross_lo(boxes[b]) && a < b);
+	});
+	HTreeVector<size_t> ranks(boxes.size());
+	HTreeVector<double> cross_starts(boxes.size());
+	for (size_t r = 0; r < by_rank.size(); r++) {
+		ranks[by_rank[r]] = r;
+		cross_starts[r] = cross_lo(boxes[by_rank[r]]);
+	}
+
+	typedef std::pair<double, size_t> HTreeSweepEnd;
+	std::priority_queue<HTreeSweepEnd, HTreeVector<HTreeSweepEnd>, std::greater<HTreeSweepEnd>> ends;
+	HTreeActiveIntervals active(boxes.size());
+	size_t first = pairs.size();
+	for (size_t i: order) {
+		const HTreeBox& b = boxes[i];
+		while (!ends.empty() && ends.top().first <= lo(b)) {
+			active.reset(ranks[ends.top().second]);
+			ends.pop();
+		}
+		size_t end = std::lower_bound(cross_starts.begin(), cross_starts.end(), (double)cross_hi(b)) -
+			cross_starts.begin();
+		active.query(end, cross_lo(b), [&](size_t r) {
+			size_t a = by_rank[r];
+			pairs.push_back(HTreeIndexPair(std::min(a, i), std::max(a, i)));
+		});
+		active.set(ranks[i], cross_hi(b));
+		ends.push(HTreeSweepEnd(hi(b), i));
+	}
+	std::sort(pairs.begin() + first, pairs.end());
+}
+
+static void htree_find_nodes_overlaps(const HTDocument* doc, const HTree* tree,
+									  const HTreeNode* parent, const HTreeNode* nodes,
+									  HTreeVector<HTOverlap>& overlaps)
+{
+	HTreeVector<const HTreeNode*> siblings;
+	HTreeVector<HTreeBox> boxes;
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		HTreeRect rect;
+		if (htree_node_absolute_rect(doc, node, &rect) == HTREE_OK) {
+			siblings.push_back(node);
+			boxes.push_back(htree_core_box_rect(rect));
+		}
+		if (node->children) {
+			htree_find_nodes_overlaps(doc, tree, node, node->children, overlaps);
+		}
+	}
+	HTreeVector<HTreeIndexPair> pairs;
+	htree_sweep_overlaps(boxes, pairs);
+	for (const HTreeIndexPair& p: pairs) {
+		HTOverlap o = {tree, parent, {siblings[p.first], siblings[p.second]}, {NULL, NULL}};
+		overlaps.push_back(o);
+	}
+}
+
+static void htree_find_labels_overlaps(const HTDocument* doc, const HTree* tree,
+									   HTreeVector<HTOverlap>& overlaps)
+{
+	HTreeVector<const HTreeEdge*> edges;
+	HTreeVector<HTreeBox> boxes;
+	for (const HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+		HTreeRect rect;
+		if (edge->label_rect && htree_edge_absolute_label(doc, edge, NULL, &rect) == HTREE_OK) {
+			edges.push_back(edge);
+			boxes.push_back(htree_core_box_rect(rect));
+		}
+	}
+	HTreeVector<HTreeIndexPair> pairs;
+	htree_sweep_overlaps(boxes, pairs);
+	for (const HTreeIndexPair& p: pairs) {
+		HTOverlap o = {tree, NULL, {NULL, NULL}, {edges[p.first], edges[p.second]}};
+		overlaps.push_back(o);
+	}
+}
+
+int htree_find_overlaps(const HTDocument* doc, HTOverlaps** result)
+{
+	if (!doc || !result) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	HTreeVector<HTOverlap> overlaps;
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		htree_find_nodes_overlaps(doc, tree, NULL, tree->nodes, overlaps);
+		htree_find_labels_overlaps(doc, tree, overlaps);
+	}
+
+	HTOverlaps* o = (HTOverlaps*)htree_alloc(sizeof(HTOverlaps));
+	o->overlaps_count = overlaps.size();
+	o->overlaps = NULL;
+	if (!overlaps.empty()) {
+		o->overlaps = (HTOverlap*)htree_alloc(sizeof(HTOverlap) * overlaps.size());
+		memcpy(o->overlaps, overlaps.data(), sizeof(HTOverlap) * overlaps.size());
+	}
+	*result = o;
+	
+	return HTREE_OK;
+}
+
+int htree_destroy_overlaps(HTOverlaps* overlaps)
+{
+	if (!overlaps) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (overlaps->overlaps) htree_free(overlaps->overlaps);
+	htree_free(overlaps);
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Spatial grid: the uniform grid of the item indexes over the absolute boxes
+ * ----------------------------------------------------------------------------- */
+
+class HTreeGrid {
+public:
+	/* about items_per_cell items of the average size in a cell */
+	HTreeGrid(const HTreeBox& bounds, size_t items, double items_per_cell = 2.0): bounds(bounds)
+	{
+		double w = bounds.x2 - bounds.x1, h = bounds.y2 - bounds.y1;
+		if (w <= 0.0) w = 1.0;
+		if (h <= 0.0) h = 1.0;
+		double cells = std::max(1.0, std::min((double)items / items_per_cell, 1048576.0));
+		cell = std::sqrt(w * h / cells);
+		columns = std::max((size_t)1, (size_t)std::ceil(w / cell));
+		rows = std::max((size_t)1, (size_t)std::ceil(h / cell));
+		buckets.resize(columns * rows);
+	}
+
+	size_t size() const { return buckets.size(); }
+	size_t column(double x) const { return clamp((x - bounds.x1) / cell, columns); }
+	size_t row(double y) const { return clamp((y - bounds.y1) / cell, rows); }
+	/* the first cell covered by both boxes */
+	size_t first_common_cell(const HTreeBox& a, const HTreeBox& b) const
+	{
+		return (std::max(row(a.y1), row(b.y1)) * columns +
+				std::max(column(a.x1), column(b.x1)));
+	}
+
+	template<class F>
+	void for_cells(const HTreeBox& box, F f) const
+	{
+		size_t c2 = column(box.x2), r2 = row(box.y2);
+		for (size_t r = row(box.y1); r <= r2; r++) {
+			for (size_t c = column(box.x1); c <= c2; c++) {
+				f(r * columns + c);
+			}
+		}
+	}
+
+	/* the cells met by the segment, including the cells it touches at the sides and
+	   corners: the rows are scanned for the part of the segment within each row */
+	template<class F>
+	void for_segment_cells(const HTreeSegment& s, F f) const
+	{
+		const double eps = cell * 1e-9;
+		double y1 = std::min(s.a.y, s.b.y), y2 = std::max(s.a.y, s.b.y);
+		double dy = s.b.y - s.a.y;
+		size_t r2 = row(y2 + eps);
+		for (size_t r = row(y1 - eps); r <= r2; r++) {
+			double lo = std::max(y1, bounds.y1 + r * cell - eps);
+			double hi = std::min(y2, bounds.y1 + (r + 1) * cell + eps);
+			double xa = s.a.x, xb = s.b.x;
+			if (dy != 0.0) {
+				xa = s.a.x + (lo - s.a.y) * (s.b.x - s.a.x) / dy;
+				xb = s.a.x + (hi - s.a.y) * (s.b.x - s.a.x) / dy;
+			}
+			size_t c2 = column(std::max(xa, xb) + eps);
+			for (size_t c = column(std::min(xa, xb) - eps); c <= c2; c++) {
+				f(r * columns + c);
+			}
+		}
+	}
+
+	void insert(const HTreeBox& box, size_t item)
+	{
+		for_cells(box, [&](size_t c) { buckets[c].push_back(item); });
+	}
+
+	void insert(const HTreeSegment& s, size_t item)
+	{
+		for_segment_cells(s, [&](size_t c) { buckets[c].push_back(item); });
+	}
+
+	const HTreeVector<size_t>& items(size_t c) const { return buckets[c]; }
+
+private:
+	static size_t clamp(double v, size_t n)
+	{
+		if (v <= 0.0) return 0;
+		size_t i = (size_t)v;
+		return i >= n ? n - 1 : i;
+	}
+
+	HTreeBox                           bounds;
+	double                             cell;
+	size_t                             columns, rows;
+	HTreeVector<HTreeVector<size_t> >  buckets;
+};
+
+/* -----------------------------------------------------------------------------
+ * Layout metrics: edge crossings & edges passing through the nodes
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+	HTreeSegment            s;
+	size_t                  edge;
+	bool                    bend;          /* the segment starts at the polyline point */
+} HTreeEdgeSegment;
+
+static HTreeBox htree_segment_box(const HTreeSegment& s)
+{
+	HTreeBox box = htree_core_box();
+	htree_core_box_add(box, s.a);
+	htree_core_box_add(box, s.b);
+	return box;
+}
+
+/* the side of the point relative to the segment line: -1, 0 or 1 */
+static int htree_point_side(const HTreeSegment& s, const HTreePoint& p)
+{
+	double c = htree_core_cross(s.b.x - s.a.x, s.b.y - s.a.y, p.x - s.a.x, p.y - s.a.y);
+	return (c > 0.0) - (c < 0.0);
+}
+
+static bool htree_same_direction(const HTreePoint& v, const HTreePoint& p1, const HTreePoint& p2)
+{
+	double x1 = p1.x - v.x, y1 = p1.y - v.y, x2 = p2.x - v.x, y2 = p2.y - v.y;
+	return htree_core_cross(x1, y1, x2, y2) == 0.0 && x1 * x2 + y1 * y2 > 0.0;
+}
+
+/* the direction to p is inside the counterclockwise sector from the direction to p1
+   to the direction to p2 */
+static bool htree_inside_sector(const HTreePoint& v, const HTreePoint& p1, const HTreePoint& p2,
+								const HTreePoint& p)
+{
+	double x1 = p1.x - v.x, y1 = p1.y - v.y, x2 = p2.x - v.x, y2 = p2.y - v.y;
+	double x = p.x - v.x, y = p.y - v.y;
+	if (htree_core_cross(x1, y1, x2, y2) >= 0.0) {
+		return htree_core_cross(x1, y1, x, y) > 0.0 && htree_core_cross(x, y, x2, y2) > 0.0;
+	}
+	return htree_core_cross(x1, y1, x, y) > 0.0 || htree_core_cross(x, y, x2, y2) > 0.0;
+}
+
+/* the polylines a1-v-a2 & b1-v-b2 with the common bend point v cross there when
+   the directions of one lie on the different sides of the other */
+static bool htree_vertex_crosses(const HTreePoint& v, const HTreePoint& a1, const HTreePoint& a2,
+								 const HTreePoint& b1, const HTreePoint& b2)
+{
+	if (htree_same_direction(v, a1, a2) ||
+		htree_same_direction(v, a1, b1) || htree_same_direction(v, a1, b2) ||
+		htree_same_direction(v, a2, b1) || htree_same_direction(v, a2, b2)) {
+		return false;
+	}
+	return htree_inside_sector(v, a1, a2, b1) != htree_inside_sector(v, a1, a2, b2);
+}
+
+/* the edges cross inside both segments or at the bend point where the polyline passes
+   to the other side; the crossing at the bend is checked for the segment starting
+   there only, the touching ends of the edges do not cross */
+static bool htree_segments_cross(const HTreeVector<HTreeEdgeSegment>& segments, size_t i, size_t j)
+{
+	const HTreeSegment& s1 = segments[i].s;
+	const HTreeSegment& s2 = segments[j].s;
+	double d1x = s1.b.x - s1.a.x, d1y = s1.b.y - s1.a.y;
+	double d2x = s2.b.x - s2.a.x, d2y = s2.b.y - s2.a.y;
+	double den = htree_core_cross(d1x, d1y, d2x, d2y);
+	if (den == 0.0) {
+		return false;
+	}
+	double ox = s2.a.x - s1.a.x, oy = s2.a.y - s1.a.y;
+	double t = htree_core_cross(ox, oy, d2x, d2y) / den;
+	double u = htree_core_cross(ox, oy, d1x, d1y) / den;
+	if (t < 0.0 || t >= 1.0 || u < 0.0 || u >= 1.0) {
+		return false;
+	}
+	if (t > 0.0 && u > 0.0) {
+		return true;
+	}
+	if (t > 0.0) {
+		return segments[j].bend && htree_point_side(s1, segments[j - 1].s.a) * htree_point_side(s1, s2.b) < 0;
+	}
+	if (u > 0.0) {
+		return segments[i].bend && htree_point_side(s2, segments[i - 1].s.a) * htree_point_side(s2, s1.b) < 0;
+	}
+	return (segments[i].bend && segments[j].bend &&
+			htree_vertex_crosses(s1.a, segments[i - 1].s.a, s1.b, segments[j - 1].s.a, s2.b));
+}
+
+/* the segment goes through the rect interior (Liang-Barsky clipping) */
+static bool htree_segment_enters_box(const HTreeSegment& s, const HTreeBox& box)
+{
+	double t0 = 0.0, t1 = 1.0;
+	double dx = s.b.x - s.a.x, dy = s.b.y - s.a.y;
+	double p[4] = {-dx, dx, -dy, dy};
+	double q[4] = {s.a.x - box.x1, box.x2 - s.a.x, s.a.y - box.y1, box.y2 - s.a.y};
+	for (int i = 0; i < 4; i++) {
+		if (p[i] == 0.0) {
+			if (q[i] <= 0.0) return false;
+		} else {
+			double r = q[i] / p[i];
+			if (p[i] < 0.0) {
+				if (r > t0) t0 = r;
+			} else {
+				if (r < t1) t1 = r;
+			}
+		}
+	}
+	return t0 < t1;
+}
+
+static bool htree_node_related(const HTreeNode* node, const HTreeNode* end)
+{
+	for (const HTreeNode* n = end; n; n = n->parent) {
+		if (n == node) return true;
+	}
+	return false;
+}
+
+static void htree_collect_node_boxes(const HTDocument* doc, const HTreeNode* nodes,
+									 HTreeVector<const HTreeNode*>& result,
+									 HTreeVector<HTreeBox>& boxes)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		HTreeRect rect;
+		if (htree_node_absolute_rect(doc, node, &rect) == HTREE_OK) {
+			result.push_back(node);
+			boxes.push_back(htree_core_box_rect(rect));
+		}
+		htree_collect_node_boxes(doc, node->children, result, boxes);
+	}
+}
+
+static void htree_tree_layout_metrics(const HTDocument* doc, const HTree* tree, HTTreeMetrics* m)
+{
+	HTreeVector<const HTreeEdge*> edges;
+	HTreeVector<HTreeEdgeSegment> segments;
+	HTreeVector<const HTreeNode*> nodes;
+	HTreeVector<HTreeBox> node_boxes;
+	HTreeBox bounds = htree_core_box();
+
+	for (const HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+		HTreePoint source, target;
+		HTreePolyline* polyline = NULL;
+		if (htree_edge_absolute_points(doc, edge, &source, &target, &polyline) != HTREE_OK) {
+			continue;
+		}
+		HTreePoint prev = source;
+		bool bend = false;
+		for (const HTreePolyline* pl = polyline; pl; pl = pl->next) {
+			segments.push_back(HTreeEdgeSegment{htree_core_segment(prev, pl->point), edges.size(), bend});
+			prev = pl->point;
+			bend = true;
+		}
+		segments.push_back(HTreeEdgeSegment{htree_core_segment(prev, target), edges.size(), bend});
+		edges.push_back(edge);
+		if (polyline) {
+			htree_destroy_polyline(polyline);
+		}
+	}
+	htree_collect_node_boxes(doc, tree->nodes, nodes, node_boxes);
+
+	m->tree = tree;
+	m->edge_crossings = m->edge_node_intersections = 0;
+	if (segments.empty()) {
+		return ;
+	}
+	for (const HTreeEdgeSegment& s: segments) {
+		htree_core_box_add(bounds, htree_segment_box(s.s));
+	}
+	for (const HTreeBox& b: node_boxes) {
+		htree_core_box_add(bounds, b);
+	}
+
+	HTreeGrid grid(bounds, segments.size() + nodes.size());
+	HTreeGrid node_grid(bounds, segments.size() + nodes.size());
+	for (size_t i = 0; i < segments.size(); i++) {
+		grid.insert(segments[i].s, i);
+	}
+	for (size_t i = 0; i < node_boxes.size(); i++) {
+		node_grid.insert(node_boxes[i], i);
+	}
+
+	/* the pair may meet in several cells, the crossing is counted once */
+	HTreeSet<unsigned long long> crossings;
+	for (size_t c = 0; c < grid.size(); c++) {
+		const HTreeVector<size_t>& items = grid.items(c);
+		for (size_t i = 0; i < items.size(); i++) {
+			for (size_t j = i + 1; j < items.size(); j++) {
+				size_t s1 = std::min(items[i], items[j]), s2 = std::max(items[i], items[j]);
+				if (segments[s1].edge != segments[s2].edge &&
+					htree_segments_cross(segments, s1, s2) &&
+					crossings.insert((unsigned long long)s1 * segments.size() + s2).second) {
+					m->edge_crossings++;
+				}
+			}
+		}
+	}
+
+	HTreeSet<unsigned long long> passed;
+	for (size_t i = 0; i < segments.size(); i++) {
+		const HTreeEdgeSegment& s = segments[i];
+		const HTreeEdge* edge = edges[s.edge];
+		node_grid.for_segment_cells(s.s, [&](size_t c) {
+			for (size_t n: node_grid.items(c)) {
+				if (htree_node_related(nodes[n], edge->source) ||
+					htree_node_related(nodes[n], edge->target) ||
+					!htree_segment_enters_box(s.s, node_boxes[n])) {
+					continue;
+				}
+				if (passed.insert((unsigned long long)s.edge * nodes.size() + n).second) {
+					m->edge_node_intersections++;
+				}
+			}
+		});
+	}
+}
+
+int htree_layout_metrics(const HTDocument* doc, HTLayoutMetrics** result)
+{
+	if (!doc || !result) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	size_t count = 0;
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		count++;
+	}
+	HTLayoutMetrics* m = (HTLayoutMetrics*)htree_alloc(sizeof(HTLayoutMetrics));
+	memset(m, 0, sizeof(HTLayoutMetrics));
+	if (count > 0) {
+		m->trees = (HTTreeMetrics*)htree_alloc(sizeof(HTTreeMetrics) * count);
+	}
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		HTTreeMetrics* tm = m->trees + m->trees_count++;
+		htree_tree_layout_metrics(doc, tree, tm);
+		m->edge_crossings += tm->edge_crossings;
+		m->edge_node_intersections += tm->edge_node_intersections;
+	}
+	*result = m;
+	
+	return HTREE_OK;
+}
+
+int htree_destroy_layout_metrics(HTLayoutMetrics* metrics)
+{
+	if (!metrics) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (metrics->trees) htree_free(metrics->trees);
+	htree_free(metrics);
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Edge labels placement
+ * ----------------------------------------------------------------------------- */
+
+#define LABEL_GAP 2.0
+
+static const double label_positions[] = {0.5, 0.4, 0.6, 0.3, 0.7, 0.2, 0.8, 0.1, 0.9};
+
+/* the point at the t share of the path length */
+static HTreePoint htree_path_point(const HTreeVector<HTreePoint>& path, double t)
+{
+	double length = 0.0;
+	for (size_t i = 1; i < path.size(); i++) {
+		length += std::hypot(path[i].x - path[i - 1].x, path[i].y - path[i - 1].y);
+	}
+	double left = length * t;
+	for (size_t i = 1; i < path.size(); i++) {
+		double l = std::hypot(path[i].x - path[i - 1].x, path[i].y - path[i - 1].y);
+		if (l > 0.0 && left <= l) {
+			double k = left / l;
+			return htree_core_point(path[i - 1].x + k * (path[i].x - path[i - 1].x),
+									path[i - 1].y + k * (path[i].y - path[i - 1].y));
+		}
+		left -= l;
+	}
+	return path.back();
+}
+
+static bool htree_boxes_overlap(const HTreeBox& a, const HTreeBox& b)
+{
+	return a.x1 < b.x2 && b.x1 < a.x2 && a.y1 < b.y2 && b.y1 < a.y2;
+}
+
+static double htree_boxes_overlap_area(const HTreeBox& a, const HTreeBox& b)
+{
+	if (!htree_boxes_overlap(a, b)) {
+		return 0.0;
+	}
+	return ((std::min(a.x2, b.x2) - std::max(a.x1, b.x1)) *
+			(std::min(a.y2, b.y2) - std::max(a.y1, b.y1)));
+}
+
+static double htree_label_conflicts(const HTreeBox& label,
+									const HTreeGrid& obstacles_grid,
+									const HTreeVector<HTreeBox>& obstacles,
+									const HTreeGrid& labels_grid,
+									const HTreeVector<HTreeBox>& labels)
+{
+	/* every box is counted in the first common cell only */
+	double area = 0.0;
+	obstacles_grid.for_cells(label, [&](size_t c) {
+		for (size_t i: obstacles_grid.items(c)) {
+			if (obstacles_grid.first_common_cell(label, obstacles[i]) == c) {
+				area += htree_boxes_overlap_area(label, obstacles[i]);
+			}
+		}
+	});
+	labels_grid.for_cells(label, [&](size_t c) {
+		for (size_t i: labels_grid.items(c)) {
+			if (labels_grid.first_common_cell(label, labels[i]) == c) {
+				area += htree_boxes_overlap_area(label, labels[i]);
+			}
+		}
+	});
+	return area;
+}
+
+static void htree_collect_leaf_boxes(const HTreeNode* nodes, HTreeVector<HTreeBox>& boxes)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		if (node->children) {
+			htree_collect_leaf_boxes(node->children, boxes);
+		} else if (node->rect) {
+			boxes.push_back(htree_core_box_rect(*(node->rect)));
+		}
+	}
+}
+
+static void htree_place_tree_labels(const HTDocument* doc, HTree* tree,
+									double width, double height, size_t* conflicts)
+{
+	HTreeVector<HTreeBox> obstacles;
+	HTreeVector<HTreeEdge*> edges;
+	HTreeVector<HTreeVector<HTreePoint> > paths;
+	HTreeBox bounds = htree_core_box();
+
+	htree_collect_leaf_boxes(tree->nodes, obstacles);
+	for (const HTreeBox& b: obstacles) {
+		htree_core_box_add(bounds, b);
+	}
+	for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+		if (!edge->label_rect && (width <= 0.0 || height <= 0.0)) {
+			continue;
+		}
+		HTreePoint source, target;
+		HTreePolyline* polyline = NULL;
+		if (htree_edge_absolute_points(doc, edge, &source, &target, &polyline) != HTREE_OK) {
+			continue;
+		}
+		HTreeVector<HTreePoint> path;
+		path.push_back(source);
+		for (const HTreePolyline* pl = polyline; pl; pl = pl->next) {
+			path.push_back(pl->point);
+		}
+		path.push_back(target);
+		if (polyline) {
+			htree_destroy_polyline(polyline);
+		}
+		for (const HTreePoint& p: path) {
+			htree_core_box_add(bounds, p);
+		}
+		edges.push_back(edge);
+		paths.push_back(path);
+	}
+	if (edges.empty()) {
+		return ;
+	}
+
+	HTreeGrid obstacles_grid(bounds, obstacles.size() + edges.size());
+	HTreeGrid labels_grid(bounds, obstacles.size() + edges.size());
+	HTreeVector<HTreeBox> labels;
+	for (size_t i = 0; i < obstacles.size(); i++) {
+		obstacles_grid.insert(obstacles[i], i);
+	}
+
+	for (size_t e = 0; e < edges.size(); e++) {
+		HTreeEdge* edge = edges[e];
+		double w = edge->label_rect ? edge->label_rect->width : width;
+		double h = edge->label_rect ? edge->label_rect->height : height;
+		HTreeBox best = htree_core_box();
+		double best_area = -1.0;
+		/* the candidates: centered on the path point, above, below, right & left of it */
+		for (double t: label_positions) {
+			HTreePoint p = htree_path_point(paths[e], t);
+			const double offsets[5][2] = {
+				{-w / 2, -h / 2},
+				{-w / 2, -h - LABEL_GAP},
+				{-w / 2, LABEL_GAP},
+				{LABEL_GAP, -h / 2},
+				{-w - LABEL_GAP, -h / 2}
+			};
+			for (int i = 0; i < 5 && best_area != 0.0; i++) {
+				HTreeBox label = {p.x + offsets[i][0], p.y + offsets[i][1],
+								  p.x + offsets[i][0] + w, p.y + offsets[i][1] + h, 2};
+				double area = htree_label_conflicts(label, obstacles_grid, obstacles,
+													labels_grid, labels);
+				if (best_area < 0.0 || area < best_area) {
+					best = label;
+					best_area = area;
+				}
+			}
+			if (best_area == 0.0) {
+				break;
+			}
+		}
+		if (best_area > 0.0 && conflicts) {
+			(*conflicts)++;
+		}
+		labels_grid.insert(best, labels.size());
+		labels.push_back(best);
+		/* the label point keeps its offset from the moved rect, the new rect gets it
+		   at the top left corner */
+		if (edge->label_rect) {
+			if (edge->label_point) {
+				htree_shift_point(edge->label_point, best.x1 - edge->label_rect->x,
+								  best.y1 - edge->label_rect->y);
+			}
+			edge->label_rect->x = (htree_coord_t)best.x1;
+			edge->label_rect->y = (htree_coord_t)best.y1;
+		} else {
+			edge->label_rect = htree_new_rect_coord_d(best.x1, best.y1, w, h);
+			if (edge->label_point) {
+				edge->label_point->x = (htree_coord_t)best.x1;
+				edge->label_point->y = (htree_coord_t)best.y1;
+			}
+		}
+	}
+}
+
+int htree_place_edge_labels(HTDocument* doc, double width, double height, size_t* conflicts)
+{
+	if (!doc) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (doc->node_coord_format != coordAbsolute ||
+		doc->edge_coord_format != coordAbsolute ||
+		doc->edge_pl_coord_format != coordAbsolute) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	HTreeAllocatorScope scope(doc);
+	if (conflicts) {
+		*conflicts = 0;
+	}
+	for (HTree* tree = doc->trees; tree; tree = tree->next) {
+		htree_place_tree_labels(doc, tree, width, height, conflicts);
+	}
+	
+	return HTREE_OK;
+}
@@ -38,13 +38,21 @@ extern "C" {
 /* -----------------------------------------------------------------------------
  * the hierarchiceal tree geometry types
  * ----------------------------------------------------------------------------- */
+
+/* the coordinates are stored as float when the library is built with
+   HTREE_FLOAT_COORDS (compact geometry storage), as double otherwise */
+#ifdef HTREE_FLOAT_COORDS
+typedef float               htree_coord_t;
+#else
+typedef double              htree_coord_t;
+#endif
 	
 typedef struct {
-    double                  x, y;
+    htree_coord_t           x, y;
 } HTreePoint;
 
 typedef struct {
-    double                  x, y, width, height;
+    htree_coord_t           x, y, width, height;
 } HTreeRect;
 
 typedef struct _HTreePolyline {
@@ -69,6 +77,11 @@ typedef struct _HTreeNode {
     struct _HTreeNode*      parent;
     struct _HTreeNode*      children;
     struct _HTreeNode*      next;
+    struct _HTreeEdge**     in_edges;        /* incoming edges index */
+    size_t                  in_edges_count;
+    struct _HTreeEdge**     out_edges;       /* outgoing edges index */
+    size_t                  out_edges_count;
+    size_t                  index;           /* the node number in the tree nodes index */
 } HTreeNode;
 
 typedef struct _HTreeEdge {
@@ -92,6 +105,8 @@ typedef struct _HTree {
     HTreeNode*              nodes;
     HTreeEdge*              edges;
     struct _HTree*          next;
+    HTreeNode**             nodes_index;     /* optional nodes numbering (depth-first order) */
+    size_t                  nodes_count;
 } HTree;
 
 typedef enum {
@@ -107,6 +122,13 @@ typedef enum {
 	edgeBorder = 2,       /* source & target points are placed on the nodes' borders */
 } HTEdgeFormat;
 	
+/* the memory allocator callbacks, NULL alloc means malloc/free */
+typedef struct {
+	void*                   (*alloc)(size_t size, void* context);
+	void                    (*free)(void* ptr, void* context);
+	void*                   context;
+} HTAllocator;
+
 typedef struct _HTDocument {
 	HTCoordFormat           node_coord_format;     /* geometry coordinate format for nodes */
 	HTCoordFormat           edge_coord_format;     /* geometry coordinate format for edge */
@@ -114,8 +136,127 @@ typedef struct _HTDocument {
 	HTEdgeFormat            edge_format;           /* edge format */
 	HTree*                  trees;                 /* the trees of nodes and edges */
 	HTreeRect*              bounding_rect;         /* bounding rect */
+	struct _HTreeOffsetsCache* offsets_cache;      /* optional cache of the absolute offsets */
+	HTAllocator             allocator;             /* the allocator active on the document creation */
+	struct _HTreePool*      pool;                  /* optional free lists of the document objects */
 } HTDocument;
 
+typedef struct {
+	HTDocument*             doc;
+	HTCoordFormat           node_coord_format;     /* the target formats */
+	HTCoordFormat           edge_coord_format;
+	HTCoordFormat           edge_pl_coord_format;
+	HTEdgeFormat            edge_format;
+	int                     result;                /* the conversion status */
+} HTConvertJob;
+
+/* the handling of the incoming node & edge ids existing in the merged document */
+typedef enum {
+	mergeKeepIds = 0,       /* the colliding ids are kept as is */
+	mergeRenameIds = 1,     /* the colliding ids get the numeric suffix */
+	mergeSkipDocument = 2,  /* the document having colliding ids is not merged */
+	mergeFail = 3           /* nothing is merged if any id collides */
+} HTMergePolicy;
+
+typedef struct _HTAsyncTask HTAsyncTask;
+
+typedef struct {
+	size_t                  trees;                 /* the document size */
+	size_t                  nodes;
+	size_t                  trees_processed;       /* every pass over the document counts the trees again */
+	size_t                  nodes_processed;
+	int                     finished;
+} HTProgress;
+
+typedef struct _HTViewport {
+	HTreeNode**             nodes;                 /* visible nodes */
+	size_t                  nodes_count;
+	HTreeNode**             collapsed_nodes;       /* composite nodes drawn as their rects only */
+	size_t                  collapsed_nodes_count;
+	HTreeEdge**             edges;                 /* visible edges */
+	size_t                  edges_count;
+} HTViewport;
+
+typedef enum {
+	issueDuplicateNodeId = 0,         /* the node id is not unique in the document */
+	issueDuplicateEdgeId = 1,         /* the edge id is not unique in the document */
+	issueDanglingEdge = 2,            /* the edge source / target id is not found in the tree */
+	issueUnboundEdge = 3,             /* the edge source / target node has another id */
+	issueMissingNodeGeometry = 4,     /* no rect (point for the point nodes) */
+	issueMissingEndpointGeometry = 5, /* the edge geometry is dropped by the conversion */
+	issueFormatMismatch = 6,          /* the geometry is set while the document format is none */
+	issueTypesCount = 7
+} HTIssueType;
+
+typedef struct {
+	HTIssueType             type;
+	const HTree*            tree;
+	const HTreeNode*        node;                  /* the node or NULL */
+	const HTreeEdge*        edge;                  /* the edge or NULL */
+	const char*             id;                    /* the problem id (the document string) */
+} HTIssue;
+
+typedef struct {
+	HTIssue*                issues;
+	size_t                  issues_count;
+} HTValidation;
+
+typedef struct {
+	const HTree*            tree;
+	const HTreeNode*        parent;                /* the composite node, NULL on the top level */
+	const HTreeNode*        nodes[2];              /* the overlapping sibling nodes */
+	const HTreeEdge*        edges[2];              /* the edges with the overlapping label rects */
+} HTOverlap;
+
+typedef struct {
+	HTOverlap*              overlaps;
+	size_t                  overlaps_count;
+} HTOverlaps;
+
+typedef struct {
+	const HTree*            tree;
+	size_t                  edge_crossings;        /* crossing points of the edges */
+	size_t                  edge_node_intersections; /* edges through the nodes other than the ends & their parents */
+} HTTreeMetrics;
+
+typedef struct {
+	HTTreeMetrics*          trees;
+	size_t                  trees_count;
+	size_t                  edge_crossings;        /* the document totals */
+	size_t                  edge_node_intersections;
+} HTLayoutMetrics;
+
+/* the estimated heap memory of the document in bytes, including the allocator overhead */
+typedef struct {
+	size_t                  nodes;                 /* node structures */
+	size_t                  edges;                 /* edge structures */
+	size_t                  geometry;              /* points & rects of the nodes, edges and the document */
+	size_t                  polylines;             /* edge polyline links */
+	size_t                  strings;               /* node & edge ids */
+	size_t                  indexes;               /* edge index arrays & offsets cache */
+	size_t                  other;                 /* document & tree structures */
+	size_t                  pooled;                /* free objects kept by the document pool */
+	size_t                  total;
+} HTMemoryUsage;
+
+typedef enum {
+	statAbsolute = 0,      /* nodes & edge points conversion to absolute coordinates */
+	statBorders = 1,       /* edge border intersections */
+	statLabels = 2,        /* edge labels conversion to absolute coordinates */
+	statBoundingRect = 3,  /* document bounding rect construction */
+	statFormat = 4,        /* conversion from absolute coordinates to the format */
+	statReconstruct = 5,   /* missing geometry reconstruction */
+	statPhasesCount = 6
+} HTStatPhase;
+
+typedef struct {
+	unsigned long long      calls[statPhasesCount];       /* number of the phase runs */
+	unsigned long long      nanoseconds[statPhasesCount]; /* total time of the phase runs */
+	unsigned long long      allocations;                  /* library objects allocated */
+	unsigned long long      allocated_bytes;
+	unsigned long long      deallocations;                /* library objects freed */
+} HTStats;
+
 /* -----------------------------------------------------------------------------
  * The hierarchical tree geometry functions
  * ----------------------------------------------------------------------------- */
@@ -125,9 +266,33 @@ typedef struct _HTDocument {
 	#define                 HTREE_BAD_PARAMETER           1
 	#define                 HTREE_NOT_FOUND               2
 	#define                 HTREE_GEOMETRY_TRANFORM_ERROR 3
+	#define                 HTREE_CANCELLED               4
+	#define                 HTREE_IN_PROGRESS             5
+	#define                 HTREE_ID_CONFLICT             6
+	#define                 HTREE_NOT_ENOUGH_MEMORY       7
+
+	/* the objects are allocated with the thread allocator if set, with the global one
+	   otherwise; the document operations use the allocator of the document, so all the
+	   document objects should be created while the same allocator is active; the objects
+	   of a custom allocator are freed by it whatever custom allocator is current, the ones
+	   created by malloc should be freed while no custom allocator is current; the global
+	   allocator may be replaced while the other threads use the library */
+	int                     htree_set_allocator(const HTAllocator* allocator);
+	int                     htree_set_thread_allocator(const HTAllocator* allocator);
+	int                     htree_get_allocator(HTAllocator* allocator);
+	/* the points, rects, polyline links, nodes and edges are cut from the slabs of the
+	   document pool while the document (or the thread document) is used, the destroyed ones
+	   are kept for reuse; trimming frees the slabs having no objects in use */
+	int                     htree_enable_document_pool(HTDocument* doc);
+	int                     htree_trim_document_pool(HTDocument* doc);
+	/* use the document allocator & pool for the objects created on the current thread,
+	   NULL to stop (the thread allocator is active again); should be reset before the
+	   document is destroyed on other threads */
+	int                     htree_set_thread_document(HTDocument* doc);
 
 	HTreePoint*             htree_new_point(void);
 	HTreePoint*             htree_new_point_coord(float x, float y);
+	HTreePoint*             htree_new_point_coord_d(double x, double y);
     HTreePoint*             htree_copy_point(const HTreePoint* src);
     int                     htree_set_point(HTreePoint* dst, const HTreePoint* src);
 	int                     htree_round_point(HTreePoint* p, unsigned int signs);
@@ -137,6 +302,7 @@ typedef struct _HTDocument {
 
 	HTreeRect*              htree_new_rect(void);
 	HTreeRect*              htree_new_rect_coord(float x, float y, float w, float h);
+	HTreeRect*              htree_new_rect_coord_d(double x, double y, double w, double h);
     HTreeRect*              htree_copy_rect(const HTreeRect* src);
 	int                     htree_init_rect(HTreeRect* rect);
 	int                     htree_set_rect(HTreeRect* dst, const HTreeRect* src);
@@ -147,14 +313,18 @@ typedef struct _HTDocument {
 	
 	HTreePolyline*          htree_new_polyline(void);
 	HTreePolyline*          htree_new_polyline_coord(float x, float y);
+	HTreePolyline*          htree_new_polyline_coord_d(double x, double y);
 	void                    htree_polyline_add_point(HTreePolyline* pl, float x, float y);
+	void                    htree_polyline_add_point_d(HTreePolyline* pl, double x, double y);
 	HTreePolyline*          htree_copy_polyline(const HTreePolyline* src);
 	int                     htree_set_polyline(HTreePolyline* dst, const HTreePolyline* src);
 	int                     htree_destroy_polyline(HTreePolyline* polyline);
 
 	HTreeNode*              htree_new_node(HTNodeType node_type, const char* _id);
 	void                    htree_node_set_rect(HTreeNode* node, float x, float y, float w, float h);
+	void                    htree_node_set_rect_d(HTreeNode* node, double x, double y, double w, double h);
 	void                    htree_node_set_point(HTreeNode* node, float x, float y);
+	void                    htree_node_set_point_d(HTreeNode* node, double x, double y);
 	void                    htree_add_sibling_node(HTreeNode* node, HTreeNode* new_node);
 	void                    htree_add_child_node(HTreeNode* node, HTreeNode* new_node);
 	HTreeNode*              htree_copy_node(const HTreeNode* src);
@@ -165,6 +335,7 @@ typedef struct _HTDocument {
 
 	HTreeEdge*              htree_new_edge(const char* _id, const char* source_id, const char* target_id);
 	void                    htree_edge_set_points(HTreeEdge* edge, float source_x, float source_y, float target_x, float target_y);
+	void                    htree_edge_set_points_d(HTreeEdge* edge, double source_x, double source_y, double target_x, double target_y);
 	HTreeEdge*              htree_copy_edge(const HTreeEdge* src);
 	int                     htree_destroy_edge(HTreeEdge* edge);
 
@@ -172,7 +343,26 @@ typedef struct _HTDocument {
 	HTree*                  htree_copy_tree(const HTree* src);
 	int                     htree_destroy_tree(HTree* tree);
 	void                    htree_add_node(HTree* tree, HTreeNode* n);
+	/* the edge ends not bound yet are resolved by the ids among the nodes already added,
+	   htree_build_adjacency resolves the ends of the edges added before their nodes */
 	void                    htree_add_edge(HTree* tree, HTreeEdge* e);	
+	int                     htree_build_adjacency(HTree* tree);
+	/* the edges index of the nodes is kept current: binding removes the edge from the
+	   previous endpoints, the destroyed edge is unbound, the edges of the destroyed node
+	   lose that end */
+	int                     htree_bind_edge(HTreeEdge* e, HTreeNode* source, HTreeNode* target);
+	int                     htree_unbind_edge(HTreeEdge* e);
+	/* the nodes index should be rebuilt after the tree nodes are added or removed */
+	int                     htree_build_nodes_index(HTree* tree);
+	int                     htree_drop_nodes_index(HTree* tree);
+	HTreeNode*              htree_node_by_index(const HTree* tree, size_t index);
+	/* the edge with the source & target resolved by the nodes index, the ids are copied
+	   from the nodes and the edge is bound to them */
+	HTreeEdge*              htree_new_edge_by_index(const HTree* tree, const char* id,
+													size_t source, size_t target);
+	/* bind the first count tree edges to the nodes by the (source, target) index pairs,
+	   the edge source & target ids are replaced by the ids of the nodes */
+	int                     htree_resolve_edges_by_index(HTree* tree, const size_t* endpoints, size_t count);
 	int                     htree_tree_has_geometry(const HTree* tree);
 
 	HTDocument*             htree_new_document(HTCoordFormat _node_coord_format,
@@ -181,6 +371,11 @@ typedef struct _HTDocument {
 											   HTEdgeFormat _edge_format);
 	void                    htree_add_tree(HTDocument* doc, HTree* tree);
 	HTDocument*             htree_copy_document(const HTDocument* src);
+	/* move every tree to a single block: the nodes (depth-first) and the edges (grouped by
+	   the source) in the traversal order, the tree edges list is reordered the same way;
+	   all the links are updated, the edges bound across the trees too; the pointers to the
+	   old objects become invalid, the pooled ones are returned to the document pool */
+	int                     htree_compact_document(HTDocument* doc);
 	int                     htree_destroy_document(HTDocument* doc);
 	int                     htree_print_document(const HTDocument* doc);
 	int                     htree_build_bounding_rect(HTDocument* doc, HTreeRect** result);
@@ -190,6 +385,98 @@ typedef struct _HTDocument {
 															HTCoordFormat new_edge_coord_format,
 															HTCoordFormat new_edge_pl_coord_format,
 															HTEdgeFormat new_edge_format);
+	/* convert the geometry into the new (or reused) document, the source is not modified */
+	int                     htree_convert_document_geometry_copy(const HTDocument* src,
+																 HTDocument** dst,
+																 HTCoordFormat new_node_coord_format,
+																 HTCoordFormat new_edge_coord_format,
+																 HTCoordFormat new_edge_pl_coord_format,
+																 HTEdgeFormat new_edge_format);
+	/* copy the node subtree with the edges between its nodes (found by the adjacency index,
+	   the ends not bound yet are resolved by the ids within the root tree) into the new tree;
+	   the geometry is relative to the top level of a document having the same formats,
+	   rebase moves the root to the origin */
+	int                     htree_extract_subtree(const HTDocument* doc, const HTreeNode* root,
+												  int rebase, HTree** result);
+	/* move the trees of the source documents to the destination one converting them to its
+	   formats, the objects are copied if the allocators or the formats differ; the merged
+	   sources are left empty and should be destroyed by the caller, the other ones are not
+	   modified; the ids are unique within the whole document, conflicts is the number of
+	   the source ids existing in the destination or in the sources merged before */
+	int                     htree_merge_documents(HTDocument* dst, HTDocument** srcs, size_t count,
+												  HTMergePolicy policy, size_t* conflicts);
+	/* convert the documents on the shared worker threads (0 means all), the status of
+	   every document is stored in its job; returns the first failed status */
+	int                     htree_convert_documents_geometry(HTConvertJob* jobs,
+															 size_t count,
+															 unsigned int threads);
+	/* the conversion (reconstruction) is queued on the background workers and runs over
+	   the document copy, the document is updated on success only and should not be changed until the task is
+	   finished; the task should be destroyed after that */
+	HTAsyncTask*            htree_convert_document_geometry_async(HTDocument* doc,
+																  HTCoordFormat new_node_coord_format,
+																  HTCoordFormat new_edge_coord_format,
+																  HTCoordFormat new_edge_pl_coord_format,
+																  HTEdgeFormat new_edge_format);
+	HTAsyncTask*            htree_reconstruct_document_geometry_async(HTDocument* doc, int reconstruct_sm);
+	int                     htree_task_progress(const HTAsyncTask* task, HTProgress* progress);
+	int                     htree_task_cancel(HTAsyncTask* task);
+	/* returns the task result or HTREE_IN_PROGRESS on timeout, negative timeout means no limit */
+	int                     htree_task_wait(HTAsyncTask* task, long timeout_ms);
+	/* cancels the queued or running task and waits for it */
+	int                     htree_destroy_task(HTAsyncTask* task);
+	/* absolute geometry on demand, the document is not modified; the offsets cache
+	   should be rebuilt after the nodes geometry is changed */
+	int                     htree_node_absolute_rect(const HTDocument* doc, const HTreeNode* node, HTreeRect* result);
+	int                     htree_node_absolute_point(const HTDocument* doc, const HTreeNode* node, HTreePoint* result);
+	int                     htree_edge_absolute_points(const HTDocument* doc, const HTreeEdge* edge,
+													   HTreePoint* source, HTreePoint* target,
+													   HTreePolyline** polyline);
+	int                     htree_edge_absolute_label(const HTDocument* doc, const HTreeEdge* edge,
+													  HTreePoint* label_point, HTreeRect* label_rect);
+	int                     htree_build_offsets_cache(HTDocument* doc);
+	int                     htree_drop_offsets_cache(HTDocument* doc);
+	/* the nodes and edges seen in the viewport in any coordinates format; the composite
+	   node is collapsed when its area at the zoom is below min_composite_size squared */
+	int                     htree_query_viewport(const HTDocument* doc,
+												 const HTreeRect* viewport,
+												 double zoom,
+												 double min_composite_size,
+												 HTViewport** result);
+	int                     htree_destroy_viewport(HTViewport* viewport);
+	/* polyline simplification (Douglas-Peucker), the trees are processed on the shared
+	   worker threads (0 means all) */
+	int                     htree_simplify_document_polylines(HTDocument* doc,
+															  double tolerance,
+															  unsigned int threads);
+	int                     htree_document_memory_usage(const HTDocument* doc, HTMemoryUsage* usage);
+	/* single pass check of the document before the conversion, the issues reference
+	   the document objects and are valid while the document is not changed */
+	int                     htree_validate_document(const HTDocument* doc, HTValidation** result);
+	int                     htree_destroy_validation(HTValidation* validation);
+	const char*             htree_issue_type_name(HTIssueType type);
+	/* overlapping sibling node rects and edge label rects of every tree (sweep line over
+	   the absolute rects, the offsets cache speeds it up); touching rects do not overlap */
+	int                     htree_find_overlaps(const HTDocument* doc, HTOverlaps** result);
+	int                     htree_destroy_overlaps(HTOverlaps* overlaps);
+	/* layout quality metrics of every tree computed over the absolute geometry with
+	   the uniform grid */
+	int                     htree_layout_metrics(const HTDocument* doc, HTLayoutMetrics** result);
+	int                     htree_destroy_layout_metrics(HTLayoutMetrics* metrics);
+	/* move the edge label rects along the edges away from the nodes & other labels, the
+	   edges without labels get the width x height ones if the size is set; the label
+	   points move with the rects; only the leaf node rects are obstacles, the labels of
+	   the inner edges are inside the composite nodes anyway; the document should be in
+	   the absolute format; conflicts is the number of overlapping labels */
+	int                     htree_place_edge_labels(HTDocument* doc, double width, double height,
+													size_t* conflicts);
+	/* performance counters (process-wide), collected only when enabled */
+	void                    htree_enable_stats(int enable);
+	int                     htree_get_stats(HTStats* stats);
+	void                    htree_reset_stats(void);
+	/* Chrome trace (JSON) of the geometry operations, the file is written on stop */
+	int                     htree_trace_start(const char* filename);
+	int                     htree_trace_stop(void);
 	
 #ifdef __cplusplus
 }
@@ -0,0 +1,279 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library: C++ interface
+ *
+ * Copyright (C) 2024-2025 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#ifndef __HIERARCHICAL_TREE_GEOMETRY_HPP
+#define __HIERARCHICAL_TREE_GEOMETRY_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+#include "htgeom.h"
+
+namespace htree {
+
+/* -----------------------------------------------------------------------------
+ * Views: ranges over the library structures, the objects are not copied
+ * ----------------------------------------------------------------------------- */
+
+	/* iterator over the lists linked by the next field */
+	template<class T>
+	class ListIterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T                         value_type;
+		typedef std::ptrdiff_t            difference_type;
+		typedef T*                        pointer;
+		typedef T&                        reference;
+
+		ListIterator(T* item = NULL): item(item) {}
+		T& operator*() const { return *item; }
+		T* operator->() const { return item; }
+		ListIterator& operator++() { item = item->next; return *this; }
+		ListIterator operator++(int) { ListIterator i = *this; item = item->next; return i; }
+		bool operator==(const ListIterator& other) const { return item == other.item; }
+		bool operator!=(const ListIterator& other) const { return item != other.item; }
+
+	private:
+		T* item;
+	};
+
+	template<class T>
+	class List {
+	public:
+		typedef ListIterator<T> iterator;
+
+		List(T* head = NULL): head(head) {}
+		iterator begin() const { return iterator(head); }
+		iterator end() const { return iterator(); }
+		bool empty() const { return head == NULL; }
+		T& front() const { return *head; }
+
+	private:
+		T* head;
+	};
+
+	/* iterator over the polyline points */
+	class PolylineIterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef HTreePoint                value_type;
+		typedef std::ptrdiff_t            difference_type;
+		typedef HTreePoint*               pointer;
+		typedef HTreePoint&               reference;
+
+		PolylineIterator(HTreePolyline* pl = NULL): pl(pl) {}
+		HTreePoint& operator*() const { return pl->point; }
+		HTreePoint* operator->() const { return &(pl->point); }
+		PolylineIterator& operator++() { pl = pl->next; return *this; }
+		PolylineIterator operator++(int) { PolylineIterator i = *this; pl = pl->next; return i; }
+		bool operator==(const PolylineIterator& other) const { return pl == other.pl; }
+		bool operator!=(const PolylineIterator& other) const { return pl != other.pl; }
+
+	private:
+		HTreePolyline* pl;
+	};
+
+	class PolylineView {
+	public:
+		typedef PolylineIterator iterator;
+
+		PolylineView(HTreePolyline* head = NULL): head(head) {}
+		iterator begin() const { return iterator(head); }
+		iterator end() const { return iterator(); }
+		bool empty() const { return head == NULL; }
+
+	private:
+		HTreePolyline* head;
+	};
+
+	/* contiguous array view (std::span replacement for C++17) */
+	template<class T>
+	class Span {
+	public:
+		typedef T* iterator;
+
+		Span(T* data = NULL, size_t size = 0): ptr(data), count(size) {}
+		iterator begin() const { return ptr; }
+		iterator end() const { return ptr + count; }
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		T& operator[](size_t i) const { return ptr[i]; }
+		T* data() const { return ptr; }
+
+	private:
+		T*     ptr;
+		size_t count;
+	};
+
+	typedef List<HTree>     TreeList;
+	typedef List<HTreeNode> NodeList;
+	typedef List<HTreeEdge> EdgeList;
+	typedef Span<HTreeEdge*> EdgeSpan;
+
+	inline TreeList trees(const HTDocument& doc) { return TreeList(doc.trees); }
+	inline NodeList nodes(const HTree& tree) { return NodeList(tree.nodes); }
+	inline EdgeList edges(const HTree& tree) { return EdgeList(tree.edges); }
+	inline NodeList children(const HTreeNode& node) { return NodeList(node.children); }
+	inline EdgeSpan in_edges(const HTreeNode& node) { return EdgeSpan(node.in_edges, node.in_edges_count); }
+	inline EdgeSpan out_edges(const HTreeNode& node) { return EdgeSpan(node.out_edges, node.out_edges_count); }
+	inline PolylineView polyline(const HTreeEdge& edge) { return PolylineView(edge.polyline); }
+
+/* -----------------------------------------------------------------------------
+ * Handles: move-only owners of the detached objects
+ * ----------------------------------------------------------------------------- */
+
+	template<class T, int (*Destroy)(T*)>
+	class Handle {
+	public:
+		explicit Handle(T* ptr = NULL): ptr(ptr) {}
+		Handle(Handle&& other) noexcept: ptr(other.release()) {}
+		Handle& operator=(Handle&& other) noexcept
+		{
+			if (this != &other) {
+				reset(other.release());
+			}
+			return *this;
+		}
+		Handle(const Handle&) = delete;
+		Handle& operator=(const Handle&) = delete;
+		~Handle() { reset(); }
+
+		T* get() const { return ptr; }
+		T* operator->() const { return ptr; }
+		T& operator*() const { return *ptr; }
+		explicit operator bool() const { return ptr != NULL; }
+
+		/* give the ownership away */
+		T* release() { T* p = ptr; ptr = NULL; return p; }
+		void reset(T* p = NULL)
+		{
+			if (ptr) {
+				Destroy(ptr);
+			}
+			ptr = p;
+		}
+
+	protected:
+		T* ptr;
+	};
+
+	class Node: public Handle<HTreeNode, htree_destroy_node> {
+	public:
+		explicit Node(HTreeNode* node = NULL): Handle(node) {}
+		Node(HTNodeType type, const char* id): Handle(htree_new_node(type, id)) {}
+
+		void set_rect(double x, double y, double w, double h) { htree_node_set_rect_d(ptr, x, y, w, h); }
+		void set_point(double x, double y) { htree_node_set_point_d(ptr, x, y); }
+		/* the child is owned by the node after that */
+		HTreeNode& add_child(Node&& child)
+		{
+			HTreeNode* n = child.release();
+			htree_add_child_node(ptr, n);
+			return *n;
+		}
+		NodeList children() const { return htree::children(*ptr); }
+		Node copy() const { return Node(htree_copy_node(ptr)); }
+	};
+
+	class Edge: public Handle<HTreeEdge, htree_destroy_edge> {
+	public:
+		explicit Edge(HTreeEdge* edge = NULL): Handle(edge) {}
+		Edge(const char* id, const char* source_id, const char* target_id):
+			Handle(htree_new_edge(id, source_id, target_id)) {}
+
+		void set_points(double source_x, double source_y, double target_x, double target_y)
+		{
+			htree_edge_set_points_d(ptr, source_x, source_y, target_x, target_y);
+		}
+		PolylineView polyline() const { return htree::polyline(*ptr); }
+		Edge copy() const { return Edge(htree_copy_edge(ptr)); }
+	};
+
+	class Tree: public Handle<HTree, htree_destroy_tree> {
+	public:
+		explicit Tree(HTree* tree = NULL): Handle(tree) {}
+		static Tree create() { return Tree(htree_new_tree()); }
+
+		HTreeNode& add(Node&& node)
+		{
+			HTreeNode* n = node.release();
+			htree_add_node(ptr, n);
+			return *n;
+		}
+		HTreeEdge& add(Edge&& edge)
+		{
+			HTreeEdge* e = edge.release();
+			htree_add_edge(ptr, e);
+			return *e;
+		}
+		int build_adjacency() { return htree_build_adjacency(ptr); }
+		NodeList nodes() const { return htree::nodes(*ptr); }
+		EdgeList edges() const { return htree::edges(*ptr); }
+	};
+
+	class Document: public Handle<HTDocument, htree_destroy_document> {
+	public:
+		explicit Document(HTDocument* doc = NULL): Handle(doc) {}
+		Document(HTCoordFormat node_coord_format,
+				 HTCoordFormat edge_coord_format,
+				 HTCoordFormat edge_pl_coord_format,
+				 HTEdgeFormat edge_format):
+			Handle(htree_new_document(node_coord_format, edge_coord_format,
+									  edge_pl_coord_format, edge_format)) {}
+
+		HTree& add(Tree&& tree)
+		{
+			HTree* t = tree.release();
+			htree_add_tree(ptr, t);
+			return *t;
+		}
+		TreeList trees() const { return htree::trees(*ptr); }
+		Document copy() const { return Document(htree_copy_document(ptr)); }
+
+		int build_bounding_rect() { return htree_build_bounding_rect(ptr, &(ptr->bounding_rect)); }
+		int reconstruct(int reconstruct_sm) { return htree_reconstruct_document_geometry(ptr, reconstruct_sm); }
+		int convert(HTCoordFormat node_coord_format,
+					HTCoordFormat edge_coord_format,
+					HTCoordFormat edge_pl_coord_format,
+					HTEdgeFormat edge_format)
+		{
+			return htree_convert_document_geometry(ptr, node_coord_format, edge_coord_format,
+												   edge_pl_coord_format, edge_format);
+		}
+		/* convert into the new document, this document is kept as is */
+		Document convert_copy(HTCoordFormat node_coord_format,
+							  HTCoordFormat edge_coord_format,
+							  HTCoordFormat edge_pl_coord_format,
+							  HTEdgeFormat edge_format) const
+		{
+			HTDocument* dst = NULL;
+			htree_convert_document_geometry_copy(ptr, &dst, node_coord_format, edge_coord_format,
+												 edge_pl_coord_format, edge_format);
+			return Document(dst);
+		}
+		int print() const { return htree_print_document(ptr); }
+	};
+
+}
+
+#endif
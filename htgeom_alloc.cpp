@@ -0,0 +1,425 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library: memory allocation
+ *
+ * Copyright (C) 2024-2025 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+
+#include "htgeom.h"
+#include "htgeom_internal.h"
+
+/* the published global allocators are immutable and kept while the process runs,
+   the other threads may still read the replaced ones */
+static std::mutex global_allocators_mutex;
+static std::deque<HTAllocator>* global_allocators = NULL;
+static thread_local HTAllocator thread_allocator = {NULL, NULL, NULL};
+static thread_local bool thread_allocator_set = false;
+
+std::atomic<const HTAllocator*> htree_global_allocator(NULL);
+thread_local const HTAllocator* htree_thread_allocator = NULL;
+thread_local struct _HTreePool* htree_thread_pool = NULL;
+
+int htree_set_allocator(const HTAllocator* allocator)
+{
+	if (allocator && (!allocator->alloc || !allocator->free)) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (!allocator) {
+		htree_global_allocator.store(NULL, std::memory_order_release);
+		return HTREE_OK;
+	}
+	std::lock_guard<std::mutex> lock(global_allocators_mutex);
+	if (!global_allocators) {
+		global_allocators = new std::deque<HTAllocator>();
+	}
+	global_allocators->push_back(*allocator);
+	htree_global_allocator.store(&global_allocators->back(), std::memory_order_release);
+	return HTREE_OK;
+}
+
+int htree_set_thread_allocator(const HTAllocator* allocator)
+{
+	if (allocator && (!allocator->alloc || !allocator->free)) {
+		return HTREE_BAD_PARAMETER;
+	}
+	thread_allocator_set = allocator != NULL;
+	if (allocator) {
+		thread_allocator = *allocator;
+		htree_thread_allocator = &thread_allocator;
+	} else {
+		htree_thread_allocator = NULL;
+	}
+	return HTREE_OK;
+}
+
+int htree_get_allocator(HTAllocator* allocator)
+{
+	if (!allocator) {
+		return HTREE_BAD_PARAMETER;
+	}
+	const HTAllocator* a = htree_current_allocator();
+	if (a) {
+		*allocator = *a;
+	} else {
+		allocator->alloc = NULL;
+		allocator->free = NULL;
+		allocator->context = NULL;
+	}
+	return HTREE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Slabs: the blocks holding several objects are registered by their address range,
+ * the objects placed in them are released to the slab owner
+ * ----------------------------------------------------------------------------- */
+
+static std::shared_mutex slabs_mutex;
+static std::map<uintptr_t, HTreeSlab*>* slabs = NULL;
+
+std::atomic<size_t> htree_slabs_count(0);
+
+static void htree_register_slab(HTreeSlab* slab)
+{
+	std::unique_lock<std::shared_mutex> lock(slabs_mutex);
+	if (!slabs) {
+		slabs = new std::map<uintptr_t, HTreeSlab*>();
+	}
+	(*slabs)[(uintptr_t)slab->begin] = slab;
+	htree_slabs_count.fetch_add(1, std::memory_order_release);
+}
+
+static void htree_unregister_slab(HTreeSlab* slab)
+{
+	std::unique_lock<std::shared_mutex> lock(slabs_mutex);
+	slabs->erase((uintptr_t)slab->begin);
+	htree_slabs_count.fetch_sub(1, std::memory_order_release);
+}
+
+HTreeSlab* htree_find_slab(const void* ptr)
+{
+	std::shared_lock<std::shared_mutex> lock(slabs_mutex);
+	if (!slabs) {
+		return NULL;
+	}
+	auto i = slabs->upper_bound((uintptr_t)ptr);
+	if (i == slabs->begin()) {
+		return NULL;
+	}
+	HTreeSlab* slab = (--i)->second;
+	return (const char*)ptr < slab->end ? slab : NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ * Document pool: the fixed size objects are cut from the slabs of the document
+ * allocator, the released objects are kept by their slab for reuse
+ * ----------------------------------------------------------------------------- */
+
+static const size_t pool_slab_objects = 32;
+
+struct _HTreePoolList;
+
+typedef struct alignas(std::max_align_t) _HTreePoolSlab {
+	HTreeSlab               slab;
+	struct _HTreePoolList*  list;
+	struct _HTreePoolSlab*  next;               /* the next slab having free objects */
+	void*                   free_list;
+	size_t                  live;               /* the objects in use */
+} HTreePoolSlab;
+
+typedef struct _HTreePoolList {
+	struct _HTreePool*      pool;
+	HTreePoolSlab*          partial;            /* the slabs having free objects */
+	size_t                  count;              /* the free objects */
+	size_t                  slot;
+} HTreePoolList;
+
+/* the pool of the destroyed document is kept until its slabs are released */
+typedef struct _HTreePool {
+	mutable std::mutex      mutex;
+	HTAllocator             allocator;
+	HTreePoolList           lists[objKindsCount];
+	size_t                  slabs;
+	bool                    orphaned;           /* the document is destroyed */
+} HTreePool;
+
+static const size_t pool_object_sizes[objKindsCount] = {
+	sizeof(HTreePoint),
+	sizeof(HTreeRect),
+	sizeof(HTreePolyline),
+	sizeof(HTreeNode),
+	sizeof(HTreeEdge)
+};
+
+static void htree_pool_release(HTreeSlab* slab, void* ptr);
+
+static HTreePoolSlab* htree_new_pool_slab(HTreePool* pool, HTreePoolList* list)
+{
+	size_t size = sizeof(HTreePoolSlab) + pool_slab_objects * list->slot;
+	if (htree_stats_active()) {
+		htree_stats_add_allocation(size);
+	}
+	const HTAllocator* a = pool->allocator.alloc ? &(pool->allocator) : NULL;
+	HTreePoolSlab* slab = (HTreePoolSlab*)htree_alloc_block(a, size);
+	if (!slab) {
+		return NULL;
+	}
+	char* objects = (char*)(slab + 1);
+	slab->slab.begin = objects;
+	slab->slab.end = objects + pool_slab_objects * list->slot;
+	slab->slab.release = htree_pool_release;
+	slab->list = list;
+	slab->live = 0;
+	slab->free_list = NULL;
+	for (size_t i = pool_slab_objects; i-- > 0;) {
+		void* p = objects + i * list->slot;
+		*(void**)p = slab->free_list;
+		slab->free_list = p;
+	}
+	slab->next = list->partial;
+	list->partial = slab;
+	list->count += pool_slab_objects;
+	pool->slabs++;
+	htree_register_slab(&(slab->slab));
+	return slab;
+}
+
+static void htree_free_pool_slab(HTreePool* pool, HTreePoolSlab* slab)
+{
+	htree_unregister_slab(&(slab->slab));
+	slab->list->count -= pool_slab_objects;
+	pool->slabs--;
+	if (htree_stats_active()) {
+		htree_stats_add_deallocation();
+	}
+	htree_release_block(pool->allocator.alloc ? &(pool->allocator) : NULL, slab);
+}
+
+void* htree_pool_alloc(HTreePool* pool, HTreeObjectKind kind, size_t)
+{
+	HTreePoolList* list = &(pool->lists[kind]);
+	std::lock_guard<std::mutex> lock(pool->mutex);
+	HTreePoolSlab* slab = list->partial;
+	if (!slab) {
+		slab = htree_new_pool_slab(pool, list);
+		if (!slab) {
+			return NULL;
+		}
+	}
+	void* p = slab->free_list;
+	slab->free_list = *(void**)p;
+	slab->live++;
+	list->count--;
+	if (!slab->free_list) {
+		list->partial = slab->next;
+	}
+	return p;
+}
+
+static void htree_delete_pool(HTreePool* pool)
+{
+	HTAllocator a = pool->allocator;
+	pool->~HTreePool();
+	if (htree_stats_active()) {
+		htree_stats_add_deallocation();
+	}
+	htree_release_block(a.alloc ? &a : NULL, pool);
+}
+
+/* frees the slabs having no objects in use, called with the pool locked */
+static void htree_trim_pool_locked(HTreePool* pool)
+{
+	for (int i = 0; i < objKindsCount; i++) {
+		HTreePoolSlab** link = &(pool->lists[i].partial);
+		while (*link) {
+			HTreePoolSlab* slab = *link;
+			if (slab->live == 0) {
+				*link = slab->next;
+				htree_free_pool_slab(pool, slab);
+			} else {
+				link = &(slab->next);
+			}
+		}
+	}
+}
+
+static void htree_pool_release(HTreeSlab* s, void* ptr)
+{
+	HTreePoolSlab* slab = (HTreePoolSlab*)s;
+	HTreePoolList* list = slab->list;
+	HTreePool* pool = list->pool;
+	bool last = false;
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		if (!slab->free_list) {
+			slab->next = list->partial;
+			list->partial = slab;
+		}
+		*(void**)ptr = slab->free_list;
+		slab->free_list = ptr;
+		slab->live--;
+		list->count++;
+		if (pool->orphaned && slab->live == 0) {
+			htree_trim_pool_locked(pool);
+			last = pool->slabs == 0;
+		}
+	}
+	if (last) {
+		htree_delete_pool(pool);
+	}
+}
+
+size_t htree_pool_memory(const HTreePool* pool, size_t* pooled)
+{
+	std::lock_guard<std::mutex> lock(pool->mutex);
+	*pooled = 0;
+	for (int i = 0; i < objKindsCount; i++) {
+		*pooled += pool->lists[i].count * pool->lists[i].slot;
+	}
+	return htree_alloc_block_size(sizeof(HTreePool));
+}
+
+/* the slabs still having objects in use are freed with their last object */
+void htree_destroy_pool(HTreePool* pool)
+{
+	bool last = false;
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		htree_trim_pool_locked(pool);
+		pool->orphaned = true;
+		last = pool->slabs == 0;
+	}
+	if (last) {
+		htree_delete_pool(pool);
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * Arena: the objects placed one after another in a single block
+ * ----------------------------------------------------------------------------- */
+
+struct alignas(std::max_align_t) _HTreeArena {
+	HTreeSlab               slab;
+	HTAllocator             allocator;
+	std::atomic<size_t>     live;               /* the objects in use and the filling */
+	size_t                  used;
+};
+
+static void htree_arena_release(HTreeSlab* slab, void*)
+{
+	HTreeArena* arena = (HTreeArena*)slab;
+	if (arena->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		htree_unregister_slab(slab);
+		HTAllocator a = arena->allocator;
+		arena->~HTreeArena();
+		if (htree_stats_active()) {
+			htree_stats_add_deallocation();
+		}
+		htree_release_block(a.alloc ? &a : NULL, arena);
+	}
+}
+
+HTreeArena* htree_new_arena(size_t size)
+{
+	void* block = htree_alloc(sizeof(HTreeArena) + size);
+	if (!block) {
+		return NULL;
+	}
+	HTreeArena* arena = new (block) HTreeArena;
+	const HTAllocator* a = htree_current_allocator();
+	arena->slab.begin = (const char*)(arena + 1);
+	arena->slab.end = arena->slab.begin + size;
+	arena->slab.release = htree_arena_release;
+	arena->allocator = a ? *a : HTAllocator{NULL, NULL, NULL};
+	arena->live.store(1, std::memory_order_relaxed);
+	arena->used = 0;
+	htree_register_slab(&(arena->slab));
+	return arena;
+}
+
+void* htree_arena_alloc(HTreeArena* arena, size_t size)
+{
+	size_t slot = htree_arena_slot(size);
+	if (arena->slab.begin + arena->used + slot > arena->slab.end) {
+		return NULL;
+	}
+	void* p = (char*)(arena + 1) + arena->used;
+	arena->used += slot;
+	arena->live.fetch_add(1, std::memory_order_relaxed);
+	return p;
+}
+
+void htree_arena_done(HTreeArena* arena)
+{
+	htree_arena_release(&(arena->slab), NULL);
+}
+
+int htree_enable_document_pool(HTDocument* doc)
+{
+	if (!doc) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (!doc->pool) {
+		HTreeAllocatorScope scope(&(doc->allocator));
+		void* block = htree_alloc(sizeof(HTreePool));
+		if (!block) {
+			return HTREE_NOT_ENOUGH_MEMORY;
+		}
+		HTreePool* pool = new (block) HTreePool;
+		pool->allocator = doc->allocator;
+		for (int i = 0; i < objKindsCount; i++) {
+			const size_t align = alignof(std::max_align_t);
+			pool->lists[i].pool = pool;
+			pool->lists[i].partial = NULL;
+			pool->lists[i].count = 0;
+			pool->lists[i].slot = (pool_object_sizes[i] + align - 1) & ~(align - 1);
+		}
+		pool->slabs = 0;
+		pool->orphaned = false;
+		doc->pool = pool;
+	}
+	return HTREE_OK;
+}
+
+int htree_trim_document_pool(HTDocument* doc)
+{
+	if (!doc || !doc->pool) {
+		return HTREE_BAD_PARAMETER;
+	}
+	std::lock_guard<std::mutex> lock(doc->pool->mutex);
+	htree_trim_pool_locked(doc->pool);
+	return HTREE_OK;
+}
+
+int htree_set_thread_document(HTDocument* doc)
+{
+	if (doc) {
+		htree_thread_allocator = &(doc->allocator);
+		htree_thread_pool = doc->pool;
+	} else {
+		/* the thread allocator is active again */
+		htree_thread_allocator = thread_allocator_set ? &thread_allocator : NULL;
+		htree_thread_pool = NULL;
+	}
+	return HTREE_OK;
+}
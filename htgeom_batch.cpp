@@ -0,0 +1,448 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library: batch conversion tool
+ *
+ * Copyright (C) 2024-2025 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "htgeom.h"
+
+/* -----------------------------------------------------------------------------
+ * The text document format (*.htg), one object per line:
+ *
+ *   document <node format> <edge format> <edge polyline format> <edge format>
+ *   tree
+ *   node <id> <parent id | -> <simple | composite | region | point> [rect x y w h] [point x y]
+ *   edge <id> <source id> <target id> [source x y] [target x y] [label x y]
+ *        [label-rect x y w h] [polyline n x1 y1 ... xn yn]
+ *
+ * the coordinate formats: none, absolute, left-top, local-center; the edge
+ * formats: none, center, border; the ids should not contain spaces
+ * ----------------------------------------------------------------------------- */
+
+static const char* coord_format_names[] = {"none", "absolute", "left-top", NULL, "local-center"};
+static const char* edge_format_names[] = {"none", "center", "border"};
+
+static bool parse_coord_format(const std::string& s, HTCoordFormat& format)
+{
+	for (int i = 0; i < 5; i++) {
+		if (coord_format_names[i] && s == coord_format_names[i]) {
+			format = (HTCoordFormat)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parse_edge_format(const std::string& s, HTEdgeFormat& format)
+{
+	for (int i = 0; i < 3; i++) {
+		if (s == edge_format_names[i]) {
+			format = (HTEdgeFormat)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parse_node_type(const std::string& s, HTNodeType& type)
+{
+	if (s == "simple") type = htSimpleNode;
+	else if (s == "composite") type = htCompositeNode;
+	else if (s == "region") type = htRegion;
+	else if (s == "point") type = htPoint;
+	else return false;
+	return true;
+}
+
+static const char* node_type_name(HTNodeType type)
+{
+	switch (type) {
+	case htCompositeNode: return "composite";
+	case htRegion: return "region";
+	case htPoint: return "point";
+	default: return "simple";
+	}
+}
+
+static HTDocument* load_document(const std::string& filename, std::string& error)
+{
+	std::ifstream in(filename);
+	if (!in) {
+		error = "cannot open the file";
+		return NULL;
+	}
+	HTDocument* doc = NULL;
+	HTree* tree = NULL;
+	std::map<std::string, HTreeNode*> nodes;
+	std::string line;
+	size_t line_num = 0;
+	while (std::getline(in, line)) {
+		line_num++;
+		std::istringstream s(line);
+		std::string kind;
+		if (!(s >> kind) || kind[0] == '#') {
+			continue;
+		}
+		bool ok = true;
+		if (kind == "document" && !doc) {
+			std::string f1, f2, f3, f4;
+			HTCoordFormat node_format, edge_format, pl_format;
+			HTEdgeFormat format;
+			ok = ((s >> f1 >> f2 >> f3 >> f4) &&
+				  parse_coord_format(f1, node_format) &&
+				  parse_coord_format(f2, edge_format) &&
+				  parse_coord_format(f3, pl_format) &&
+				  parse_edge_format(f4, format));
+			if (ok) {
+				doc = htree_new_document(node_format, edge_format, pl_format, format);
+			}
+		} else if (kind == "tree" && doc) {
+			if (tree) {
+				htree_build_adjacency(tree);
+			}
+			tree = htree_new_tree();
+			htree_add_tree(doc, tree);
+			nodes.clear();
+		} else if (kind == "node" && tree) {
+			std::string id, parent, type_name, attr;
+			HTNodeType type;
+			ok = (s >> id >> parent >> type_name) && parse_node_type(type_name, type) &&
+				nodes.find(id) == nodes.end();
+			HTreeNode* node = ok ? htree_new_node(type, id.c_str()) : NULL;
+			while (ok && s >> attr) {
+				double x, y, w, h;
+				if (attr == "rect" && (s >> x >> y >> w >> h)) {
+					htree_node_set_rect_d(node, x, y, w, h);
+				} else if (attr == "point" && (s >> x >> y)) {
+					htree_node_set_point_d(node, x, y);
+				} else {
+					ok = false;
+				}
+			}
+			if (ok && parent != "-") {
+				auto p = nodes.find(parent);
+				ok = p != nodes.end();
+				if (ok) {
+					htree_add_child_node(p->second, node);
+				}
+			} else if (ok) {
+				htree_add_node(tree, node);
+			}
+			if (ok) {
+				nodes[id] = node;
+			} else if (node) {
+				htree_destroy_node(node);
+			}
+		} else if (kind == "edge" && tree) {
+			std::string id, source, target, attr;
+			ok = (bool)(s >> id >> source >> target);
+			HTreeEdge* edge = ok ? htree_new_edge(id.c_str(), source.c_str(), target.c_str()) : NULL;
+			HTreePolyline* last = NULL;
+			while (ok && s >> attr) {
+				double x, y, w, h;
+				size_t n;
+				if (attr == "source" && (s >> x >> y)) {
+					edge->source_point = htree_new_point_coord_d(x, y);
+				} else if (attr == "target" && (s >> x >> y)) {
+					edge->target_point = htree_new_point_coord_d(x, y);
+				} else if (attr == "label" && (s >> x >> y)) {
+					edge->label_point = htree_new_point_coord_d(x, y);
+				} else if (attr == "label-rect" && (s >> x >> y >> w >> h)) {
+					edge->label_rect = htree_new_rect_coord_d(x, y, w, h);
+				} else if (attr == "polyline" && (s >> n)) {
+					for (size_t i = 0; ok && i < n; i++) {
+						ok = (bool)(s >> x >> y);
+						if (ok && last) {
+							htree_polyline_add_point_d(last, x, y);
+							last = last->next;
+						} else if (ok) {
+							edge->polyline = last = htree_new_polyline_coord_d(x, y);
+						}
+					}
+				} else {
+					ok = false;
+				}
+			}
+			if (ok) {
+				auto s_node = nodes.find(source), t_node = nodes.find(target);
+				htree_bind_edge(edge,
+								s_node != nodes.end() ? s_node->second : NULL,
+								t_node != nodes.end() ? t_node->second : NULL);
+				htree_add_edge(tree, edge);
+			} else if (edge) {
+				htree_destroy_edge(edge);
+			}
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			error = "bad line " + std::to_string(line_num);
+			htree_destroy_document(doc);
+			return NULL;
+		}
+	}
+	if (!doc) {
+		error = "no document";
+		return NULL;
+	}
+	if (tree) {
+		htree_build_adjacency(tree);
+	}
+	return doc;
+}
+
+static void write_point(std::ostream& os, const char* name, const HTreePoint* p)
+{
+	if (p) {
+		os << " " << name << " " << p->x << " " << p->y;
+	}
+}
+
+static void write_rect(std::ostream& os, const char* name, const HTreeRect* r)
+{
+	if (r) {
+		os << " " << name << " " << r->x << " " << r->y << " " << r->width << " " << r->height;
+	}
+}
+
+static void write_nodes(std::ostream& os, const HTreeNode* nodes)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		os << "node " << node->id << " " << (node->parent ? node->parent->id : "-") << " "
+		   << node_type_name(node->type);
+		write_rect(os, "rect", node->rect);
+		write_point(os, "point", node->point);
+		os << "\n";
+		write_nodes(os, node->children);
+	}
+}
+
+static bool write_document(const std::string& filename, const HTDocument* doc)
+{
+	std::ofstream os(filename);
+	if (!os) {
+		return false;
+	}
+	os.precision(std::numeric_limits<htree_coord_t>::max_digits10);
+	os << "document " << coord_format_names[doc->node_coord_format] << " "
+	   << coord_format_names[doc->edge_coord_format] << " "
+	   << coord_format_names[doc->edge_pl_coord_format] << " "
+	   << edge_format_names[doc->edge_format] << "\n";
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		os << "tree\n";
+		write_nodes(os, tree->nodes);
+		for (const HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+			os << "edge " << edge->id << " " << edge->source_id << " " << edge->target_id;
+			write_point(os, "source", edge->source_point);
+			write_point(os, "target", edge->target_point);
+			write_point(os, "label", edge->label_point);
+			write_rect(os, "label-rect", edge->label_rect);
+			if (edge->polyline) {
+				size_t n = 0;
+				for (const HTreePolyline* pl = edge->polyline; pl; pl = pl->next) n++;
+				os << " polyline " << n;
+				for (const HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
+					os << " " << pl->point.x << " " << pl->point.y;
+				}
+			}
+			os << "\n";
+		}
+	}
+	return (bool)os;
+}
+
+/* -----------------------------------------------------------------------------
+ * The batch driver
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+	std::string             name;
+	double                  load_ms, process_ms, write_ms;
+	size_t                  trees, nodes, memory;
+	int                     result;
+	std::string             error;
+} FileResult;
+
+static size_t count_nodes(const HTreeNode* nodes)
+{
+	size_t count = 0;
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		count += 1 + count_nodes(node->children);
+	}
+	return count;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point& start)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(now - start).count();
+	start = now;
+	return ms;
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-j threads] [-o output-dir] -r | -c <node> <edge> <polyline> <edge-format> <input-dir>\n",
+			name);
+	fprintf(stderr, "  -r  reconstruct the missing geometry\n");
+	fprintf(stderr, "  -c  convert the geometry into the formats: none, absolute, left-top, local-center;\n");
+	fprintf(stderr, "      the edge format: none, center, border\n");
+	fprintf(stderr, "The *.htg documents are processed, the results are written into the output dir.\n");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int threads = std::thread::hardware_concurrency();
+	std::string input_dir, output_dir;
+	bool reconstruct = false, convert = false;
+	HTCoordFormat node_format = coordAbsolute, edge_format = coordAbsolute, pl_format = coordAbsolute;
+	HTEdgeFormat format = edgeBorder;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output_dir = argv[++i];
+		} else if (strcmp(argv[i], "-r") == 0) {
+			reconstruct = true;
+		} else if (strcmp(argv[i], "-c") == 0 && i + 4 < argc) {
+			convert = (parse_coord_format(argv[i + 1], node_format) &&
+					   parse_coord_format(argv[i + 2], edge_format) &&
+					   parse_coord_format(argv[i + 3], pl_format) &&
+					   parse_edge_format(argv[i + 4], format));
+			if (!convert) {
+				usage(argv[0]);
+				return 1;
+			}
+			i += 4;
+		} else if (input_dir.empty() && argv[i][0] != '-') {
+			input_dir = argv[i];
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (input_dir.empty() || reconstruct == convert) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (threads == 0) {
+		threads = 1;
+	}
+
+	std::vector<FileResult> files;
+	std::error_code ec;
+	for (const auto& entry: std::filesystem::directory_iterator(input_dir, ec)) {
+		if (entry.is_regular_file() && entry.path().extension() == ".htg") {
+			FileResult r;
+			r.name = entry.path().filename().string();
+			r.load_ms = r.process_ms = r.write_ms = 0.0;
+			r.trees = r.nodes = r.memory = 0;
+			r.result = HTREE_OK;
+			files.push_back(r);
+		}
+	}
+	if (ec) {
+		fprintf(stderr, "Cannot read the directory %s: %s\n", input_dir.c_str(), ec.message().c_str());
+		return 1;
+	}
+	std::sort(files.begin(), files.end(), [](const FileResult& a, const FileResult& b) {
+		return a.name < b.name;
+	});
+	if (!output_dir.empty()) {
+		std::filesystem::create_directories(output_dir, ec);
+	}
+
+	std::chrono::steady_clock::time_point batch_start = std::chrono::steady_clock::now();
+	std::atomic<size_t> next_file(0);
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads && t < files.size(); t++) {
+		workers.push_back(std::thread([&]() {
+			size_t index;
+			while ((index = next_file++) < files.size()) {
+				FileResult& r = files[index];
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				HTDocument* doc = load_document((std::filesystem::path(input_dir) / r.name).string(), r.error);
+				r.load_ms = elapsed_ms(start);
+				if (!doc) {
+					r.result = HTREE_BAD_PARAMETER;
+					continue;
+				}
+				for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+					r.trees++;
+					r.nodes += count_nodes(tree->nodes);
+				}
+				if (reconstruct) {
+					r.result = htree_reconstruct_document_geometry(doc, 1);
+				} else {
+					r.result = htree_convert_document_geometry(doc, node_format, edge_format,
+															   pl_format, format);
+				}
+				r.process_ms = elapsed_ms(start);
+				HTMemoryUsage usage;
+				htree_document_memory_usage(doc, &usage);
+				r.memory = usage.total;
+				if (r.result == HTREE_OK && !output_dir.empty()) {
+					if (!write_document((std::filesystem::path(output_dir) / r.name).string(), doc)) {
+						r.error = "cannot write the result";
+					}
+					r.write_ms = elapsed_ms(start);
+				}
+				htree_destroy_document(doc);
+			}
+		}));
+	}
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	double total_ms = elapsed_ms(batch_start);
+
+	size_t failed = 0, nodes = 0;
+	double process_ms = 0.0;
+	for (const FileResult& r: files) {
+		if (r.result != HTREE_OK || !r.error.empty()) {
+			printf("%s: error %d %s\n", r.name.c_str(), r.result, r.error.c_str());
+			failed++;
+			continue;
+		}
+		printf("%s: %zu trees, %zu nodes, load %.3f ms, process %.3f ms, write %.3f ms, memory %zu bytes\n",
+			   r.name.c_str(), r.trees, r.nodes, r.load_ms, r.process_ms, r.write_ms, r.memory);
+		nodes += r.nodes;
+		process_ms += r.process_ms;
+	}
+	printf("%zu files (%zu failed), %zu nodes, %u threads: total %.3f ms, processing %.3f ms, %.0f nodes/s\n",
+		   files.size(), failed, nodes, threads, total_ms, process_ms,
+		   total_ms > 0.0 ? nodes * 1000.0 / total_ms : 0.0);
+	return failed ? 1 : 0;
+}
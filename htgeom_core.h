@@ -0,0 +1,182 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library: internal geometry core
+ *
+ * Copyright (C) 2024-2025 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#ifndef __HIERARCHICAL_TREE_GEOMETRY_CORE_H
+#define __HIERARCHICAL_TREE_GEOMETRY_CORE_H
+
+#include "htgeom.h"
+
+/* -----------------------------------------------------------------------------
+ * Axis-aligned geometry used on the hot paths instead of the homogeneous
+ * coordinates: points, boxes, segments and segment/box clipping
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+	double                  x1, y1, x2, y2;
+	size_t                  count;            /* number of the included points */
+} HTreeBox;
+
+typedef struct {
+	HTreePoint              a, b;
+} HTreeSegment;
+
+constexpr HTreePoint htree_core_point(double x, double y)
+{
+	return HTreePoint{(htree_coord_t)x, (htree_coord_t)y};
+}
+
+constexpr HTreeBox htree_core_box(void)
+{
+	return HTreeBox{0.0, 0.0, 0.0, 0.0, 0};
+}
+
+constexpr HTreeBox htree_core_box_rect(const HTreeRect& r)
+{
+	return HTreeBox{r.x, r.y, r.x + r.width, r.y + r.height, 2};
+}
+
+constexpr HTreeSegment htree_core_segment(const HTreePoint& a, const HTreePoint& b)
+{
+	return HTreeSegment{a, b};
+}
+
+inline void htree_core_box_add(HTreeBox& box, double x, double y)
+{
+	if (box.count == 0) {
+		box.x1 = box.x2 = x;
+		box.y1 = box.y2 = y;
+	} else {
+		if (x < box.x1) box.x1 = x;
+		if (x > box.x2) box.x2 = x;
+		if (y < box.y1) box.y1 = y;
+		if (y > box.y2) box.y2 = y;
+	}
+	box.count++;
+}
+
+inline void htree_core_box_add(HTreeBox& box, const HTreePoint& p)
+{
+	htree_core_box_add(box, p.x, p.y);
+}
+
+inline void htree_core_box_add(HTreeBox& box, const HTreeBox& other)
+{
+	if (other.count == 0) return ;
+	htree_core_box_add(box, other.x1, other.y1);
+	htree_core_box_add(box, other.x2, other.y2);
+}
+
+inline void htree_core_box_add(HTreeBox& box, const HTreeRect& r)
+{
+	htree_core_box_add(box, r.x, r.y);
+	htree_core_box_add(box, r.x + r.width, r.y + r.height);
+}
+
+/* the box has at least two points and is not flat */
+constexpr bool htree_core_box_valid(const HTreeBox& box)
+{
+	return box.count >= 2 && box.x1 != box.x2 && box.y1 != box.y2;
+}
+
+constexpr HTreeRect htree_core_box_to_rect(const HTreeBox& box)
+{
+	return HTreeRect{(htree_coord_t)box.x1, (htree_coord_t)box.y1,
+					 (htree_coord_t)(box.x2 - box.x1), (htree_coord_t)(box.y2 - box.y1)};
+}
+
+constexpr bool htree_core_boxes_intersect(const HTreeBox& a, const HTreeBox& b)
+{
+	return a.x1 <= b.x2 && a.x2 >= b.x1 && a.y1 <= b.y2 && a.y2 >= b.y1;
+}
+
+constexpr bool htree_core_points_less(const HTreePoint& a, const HTreePoint& b)
+{
+	return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+constexpr double htree_core_cross(double ax, double ay, double bx, double by)
+{
+	return ax * by - ay * bx;
+}
+
+/* the intersection point of two segments, parallel segments do not intersect */
+inline bool htree_core_segments_intersection(const HTreeSegment& s1,
+											 const HTreeSegment& s2,
+											 HTreePoint* result)
+{
+	double d1x = s1.b.x - s1.a.x, d1y = s1.b.y - s1.a.y;
+	double d2x = s2.b.x - s2.a.x, d2y = s2.b.y - s2.a.y;
+	double den = htree_core_cross(d1x, d1y, d2x, d2y);
+	if (den == 0.0) {
+		return false;
+	}
+	double ox = s2.a.x - s1.a.x, oy = s2.a.y - s1.a.y;
+	double t = htree_core_cross(ox, oy, d2x, d2y) / den;
+	double u = htree_core_cross(ox, oy, d1x, d1y) / den;
+	if (t < 0.0 || t > 1.0 || u < 0.0 || u > 1.0) {
+		return false;
+	}
+	if (result) {
+		result->x = s1.a.x + t * d1x;
+		result->y = s1.a.y + t * d1y;
+	}
+	return true;
+}
+
+/* the crossing points of the segment and the rect border sorted by (x, y),
+   returns the number of the points (up to 4) */
+inline size_t htree_core_segment_rect_intersections(const HTreeSegment& s,
+													const HTreeRect& r,
+													HTreePoint result[4])
+{
+	const HTreePoint corners[4] = {
+		htree_core_point(r.x, r.y),
+		htree_core_point(r.x + r.width, r.y),
+		htree_core_point(r.x + r.width, r.y + r.height),
+		htree_core_point(r.x, r.y + r.height)
+	};
+	size_t count = 0;
+	for (size_t i = 0; i < 4; i++) {
+		HTreePoint p;
+		if (!htree_core_segments_intersection(s, htree_core_segment(corners[i], corners[(i + 1) % 4]), &p)) {
+			continue;
+		}
+		bool found = false;
+		for (size_t j = 0; j < count; j++) {
+			if (result[j].x == p.x && result[j].y == p.y) {
+				found = true;
+				break;
+			}
+		}
+		if (found) continue;
+		/* insertion sort */
+		size_t j = count++;
+		while (j > 0 && htree_core_points_less(p, result[j - 1])) {
+			result[j] = result[j - 1];
+			j--;
+		}
+		result[j] = p;
+	}
+	return count;
+}
+
+#endif
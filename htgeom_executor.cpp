@@ -0,0 +1,470 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library: shared worker threads
+ *
+ * Copyright (C) 2024-2025 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "htgeom.h"
+#include "htgeom_internal.h"
+
+/* -----------------------------------------------------------------------------
+ * Executor: the persistent workers started on the first parallel job; every
+ * participant has its own queue of the task indexes and steals from the others
+ * when the queue is empty
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+	std::mutex              mutex;
+	std::deque<size_t>      items;
+} HTreeTaskQueue;
+
+/* the workers and the thread running the job, the nested jobs are run inline */
+static thread_local bool executor_participant = false;
+
+static size_t htree_executor_threads(void)
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return n < 2 ? 2 : n;
+}
+
+class HTreeExecutor {
+public:
+	HTreeExecutor(): queues(htree_executor_threads()), stop(false), active(false), generation(0),
+					 participants(0), busy(0), task(NULL), pending(0)
+	{
+		for (size_t i = 1; i < queues.size(); i++) {
+			workers.push_back(std::thread(&HTreeExecutor::worker_loop, this, i));
+		}
+	}
+
+	~HTreeExecutor()
+	{
+		{
+			std::lock_guard<std::mutex> lock(state_mutex);
+			stop = true;
+		}
+		wake.notify_all();
+		for (size_t i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+	}
+
+	size_t size() const { return queues.size(); }
+
+	void run(size_t count, size_t threads, const std::function<void(size_t)>& f)
+	{
+		std::lock_guard<std::mutex> job_lock(job_mutex);
+		for (size_t p = 0; p < threads; p++) {
+			HTreeTaskQueue& q = queues[p];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			for (size_t i = p * count / threads; i < (p + 1) * count / threads; i++) {
+				q.items.push_back(i);
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(state_mutex);
+			task = &f;
+			error = NULL;
+			pending = count;
+			participants = threads;
+			active = true;
+			generation++;
+		}
+		wake.notify_all();
+
+		executor_participant = true;
+		participate(0);
+		executor_participant = false;
+		
+		std::unique_lock<std::mutex> lock(state_mutex);
+		done.wait(lock, [this]() { return pending == 0 && busy == 0; });
+		active = false;
+		task = NULL;
+		if (error) {
+			std::exception_ptr e = error;
+			error = NULL;
+			std::rethrow_exception(e);
+		}
+	}
+
+private:
+	bool pop(size_t p, size_t& index)
+	{
+		{
+			HTreeTaskQueue& q = queues[p];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (!q.items.empty()) {
+				index = q.items.front();
+				q.items.pop_front();
+				return true;
+			}
+		}
+		for (size_t i = 1; i < participants; i++) {
+			HTreeTaskQueue& q = queues[(p + i) % participants];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (!q.items.empty()) {
+				index = q.items.back();
+				q.items.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void participate(size_t p)
+	{
+		size_t index;
+		while (pop(p, index)) {
+			try {
+				(*task)(index);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(state_mutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+			std::lock_guard<std::mutex> lock(state_mutex);
+			if (--pending == 0) {
+				done.notify_all();
+			}
+		}
+	}
+
+	void worker_loop(size_t p)
+	{
+		executor_participant = true;
+		unsigned long long seen = 0;
+		std::unique_lock<std::mutex> lock(state_mutex);
+		while (true) {
+			wake.wait(lock, [&]() { return stop || generation != seen; });
+			if (stop) {
+				break;
+			}
+			seen = generation;
+			if (!active || p >= participants) {
+				continue;
+			}
+			busy++;
+			lock.unlock();
+			participate(p);
+			lock.lock();
+			if (--busy == 0) {
+				done.notify_all();
+			}
+		}
+	}
+
+	std::vector<std::thread>                 workers;
+	std::vector<HTreeTaskQueue>              queues;
+	std::mutex                               job_mutex;
+	std::mutex                               state_mutex;
+	std::condition_variable                  wake;
+	std::condition_variable                  done;
+	bool                                     stop;
+	bool                                     active;
+	unsigned long long                       generation;
+	size_t                                   participants;
+	size_t                                   busy;
+	const std::function<void(size_t)>*       task;
+	size_t                                   pending;
+	std::exception_ptr                       error;
+};
+
+static HTreeExecutor& htree_executor(void)
+{
+	static HTreeExecutor executor;
+	return executor;
+}
+
+void htree_parallel_for(size_t count, unsigned int threads, const std::function<void(size_t)>& task)
+{
+	if (count == 0) {
+		return ;
+	}
+	if (threads == 1 || count == 1 || executor_participant) {
+		/* nested jobs are run by the participant itself */
+		for (size_t i = 0; i < count; i++) {
+			task(i);
+		}
+		return ;
+	}
+	HTreeExecutor& executor = htree_executor();
+	size_t n = executor.size();
+	if (threads > 0 && threads < n) {
+		n = threads;
+	}
+	if (n > count) {
+		n = count;
+	}
+	executor.run(count, n, task);
+}
+
+/* -----------------------------------------------------------------------------
+ * Asynchronous tasks: the operation is queued on the async workers and runs over
+ * the document copy, the copy is swapped with the document on success
+ * ----------------------------------------------------------------------------- */
+
+thread_local HTreeTaskState* htree_thread_task = NULL;
+
+struct _HTAsyncTask {
+	HTDocument*             doc;
+	std::function<int(HTDocument*, HTDocument**)> operation;
+	std::mutex              mutex;
+	std::condition_variable cv;
+	bool                    finished;
+	int                     result;
+	size_t                  trees;
+	size_t                  nodes;
+	HTreeTaskState          state;
+};
+
+static size_t htree_task_count_nodes(const HTreeNode* nodes)
+{
+	size_t count = 0;
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		count += 1 + htree_task_count_nodes(node->children);
+	}
+	return count;
+}
+
+void htree_task_add_tree(HTreeTaskState* state, const HTree* tree)
+{
+	state->trees_processed.fetch_add(1, std::memory_order_relaxed);
+	state->nodes_processed.fetch_add(htree_task_count_nodes(tree->nodes), std::memory_order_relaxed);
+}
+
+static void htree_task_swap_documents(HTDocument* doc, HTDocument* copy)
+{
+	if (doc->offsets_cache) {
+		htree_drop_offsets_cache(doc);
+	}
+	std::swap(doc->trees, copy->trees);
+	std::swap(doc->bounding_rect, copy->bounding_rect);
+	doc->node_coord_format = copy->node_coord_format;
+	doc->edge_coord_format = copy->edge_coord_format;
+	doc->edge_pl_coord_format = copy->edge_pl_coord_format;
+	doc->edge_format = copy->edge_format;
+}
+
+static void htree_run_task(HTAsyncTask* task)
+{
+	HTDocument* copy = NULL;
+	int res = HTREE_CANCELLED;
+	if (!task->state.cancelled) {
+		htree_thread_task = &(task->state);
+		res = task->operation(task->doc, &copy);
+		htree_thread_task = NULL;
+	}
+	{
+		std::lock_guard<std::mutex> lock(task->mutex);
+		if (task->state.cancelled) {
+			res = HTREE_CANCELLED;
+		} else if (res == HTREE_OK) {
+			htree_task_swap_documents(task->doc, copy);
+		}
+		task->result = res;
+	}
+	/* the copy keeps the old geometry now */
+	htree_destroy_document(copy);
+	std::lock_guard<std::mutex> lock(task->mutex);
+	task->finished = true;
+	task->cv.notify_all();
+}
+
+/* the few persistent workers running the queued tasks in order */
+class HTreeAsyncExecutor {
+public:
+	HTreeAsyncExecutor(): stop(false)
+	{
+		/* the tasks use the shared workers, so they are destroyed after this executor */
+		htree_executor();
+		size_t n = htree_executor_threads() / 2;
+		for (size_t i = 0; i < n; i++) {
+			workers.push_back(std::thread(&HTreeAsyncExecutor::worker_loop, this));
+		}
+	}
+
+	~HTreeAsyncExecutor()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+		for (size_t i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+	}
+
+	void post(HTAsyncTask* task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(task);
+		}
+		wake.notify_one();
+	}
+
+private:
+	void worker_loop()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			wake.wait(lock, [this]() { return stop || !tasks.empty(); });
+			if (tasks.empty()) {
+				break;
+			}
+			HTAsyncTask* task = tasks.front();
+			tasks.pop_front();
+			lock.unlock();
+			htree_run_task(task);
+			lock.lock();
+		}
+	}
+
+	std::vector<std::thread>                 workers;
+	std::deque<HTAsyncTask*>                 tasks;
+	std::mutex                               mutex;
+	std::condition_variable                  wake;
+	bool                                     stop;
+};
+
+static HTreeAsyncExecutor& htree_async_executor(void)
+{
+	static HTreeAsyncExecutor executor;
+	return executor;
+}
+
+/* operation builds the processed copy of the document */
+static HTAsyncTask* htree_start_task(HTDocument* doc,
+									 const std::function<int(HTDocument*, HTDocument**)>& operation)
+{
+	HTAsyncTask* task = new HTAsyncTask;
+	task->doc = doc;
+	task->operation = operation;
+	task->finished = false;
+	task->result = HTREE_IN_PROGRESS;
+	task->trees = task->nodes = 0;
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		task->trees++;
+		task->nodes += htree_task_count_nodes(tree->nodes);
+	}
+	task->state.cancelled = false;
+	task->state.trees_processed = 0;
+	task->state.nodes_processed = 0;
+	htree_async_executor().post(task);
+	return task;
+}
+
+HTAsyncTask* htree_convert_document_geometry_async(HTDocument* doc,
+												   HTCoordFormat new_node_coord_format,
+												   HTCoordFormat new_edge_coord_format,
+												   HTCoordFormat new_edge_pl_coord_format,
+												   HTEdgeFormat new_edge_format)
+{
+	if (!doc) {
+		return NULL;
+	}
+	return htree_start_task(doc, [=](HTDocument* src, HTDocument** copy) {
+		return htree_convert_document_geometry_copy(src, copy,
+													new_node_coord_format,
+													new_edge_coord_format,
+													new_edge_pl_coord_format,
+													new_edge_format);
+	});
+}
+
+HTAsyncTask* htree_reconstruct_document_geometry_async(HTDocument* doc, int reconstruct_sm)
+{
+	if (!doc || !doc->trees) {
+		return NULL;
+	}
+	return htree_start_task(doc, [=](HTDocument* src, HTDocument** copy) {
+		*copy = htree_copy_document(src);
+		if (!*copy) {
+			return HTREE_GEOMETRY_TRANFORM_ERROR;
+		}
+		if (htree_task_cancelled()) {
+			return HTREE_CANCELLED;
+		}
+		return htree_reconstruct_document_geometry(*copy, reconstruct_sm);
+	});
+}
+
+int htree_task_progress(const HTAsyncTask* task, HTProgress* progress)
+{
+	if (!task || !progress) {
+		return HTREE_BAD_PARAMETER;
+	}
+	progress->trees = task->trees;
+	progress->nodes = task->nodes;
+	progress->trees_processed = task->state.trees_processed.load(std::memory_order_relaxed);
+	progress->nodes_processed = task->state.nodes_processed.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(((HTAsyncTask*)task)->mutex);
+	progress->finished = task->finished;
+	return HTREE_OK;
+}
+
+int htree_task_cancel(HTAsyncTask* task)
+{
+	if (!task) {
+		return HTREE_BAD_PARAMETER;
+	}
+	std::lock_guard<std::mutex> lock(task->mutex);
+	if (task->result == HTREE_IN_PROGRESS) {
+		task->state.cancelled = true;
+	}
+	return HTREE_OK;
+}
+
+int htree_task_wait(HTAsyncTask* task, long timeout_ms)
+{
+	if (!task) {
+		return HTREE_BAD_PARAMETER;
+	}
+	std::unique_lock<std::mutex> lock(task->mutex);
+	if (timeout_ms < 0) {
+		task->cv.wait(lock, [task]() { return task->finished; });
+	} else if (!task->cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+								  [task]() { return task->finished; })) {
+		return HTREE_IN_PROGRESS;
+	}
+	return task->result;
+}
+
+int htree_destroy_task(HTAsyncTask* task)
+{
+	if (!task) {
+		return HTREE_BAD_PARAMETER;
+	}
+	htree_task_cancel(task);
+	{
+		std::unique_lock<std::mutex> lock(task->mutex);
+		task->cv.wait(lock, [task]() { return task->finished; });
+	}
+	delete task;
+	return HTREE_OK;
+}
@@ -0,0 +1,396 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library: internal definitions
+ *
+ * Copyright (C) 2024-2025 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+
+#ifndef __HIERARCHICAL_TREE_GEOMETRY_INTERNAL_H
+#define __HIERARCHICAL_TREE_GEOMETRY_INTERNAL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "htgeom.h"
+
+/* -----------------------------------------------------------------------------
+ * Tracing: the scoped events are written to the Chrome trace file
+ * ----------------------------------------------------------------------------- */
+
+extern std::atomic<bool> htree_trace_enabled;
+
+inline bool htree_trace_active(void)
+{
+	return htree_trace_enabled.load(std::memory_order_relaxed);
+}
+
+unsigned long long htree_trace_clock(void);
+void htree_trace_add_event(const char* name, unsigned long long start, unsigned long long end,
+						   const HTDocument* doc, const HTree* tree);
+
+/* records the enclosing block as an event with the document or the tree sizes as args */
+class HTreeTraceScope {
+public:
+	HTreeTraceScope(const char* name, const HTDocument* doc):
+		name(name), doc(doc), tree(NULL), active(htree_trace_active())
+	{
+		if (active) {
+			start = htree_trace_clock();
+		}
+	}
+	HTreeTraceScope(const char* name, const HTree* tree):
+		name(name), doc(NULL), tree(tree), active(htree_trace_active())
+	{
+		if (active) {
+			start = htree_trace_clock();
+		}
+	}
+	~HTreeTraceScope()
+	{
+		if (active) {
+			htree_trace_add_event(name, start, htree_trace_clock(), doc, tree);
+		}
+	}
+	HTreeTraceScope(const HTreeTraceScope&) = delete;
+	HTreeTraceScope& operator=(const HTreeTraceScope&) = delete;
+
+private:
+	const char*                           name;
+	const HTDocument*                     doc;
+	const HTree*                          tree;
+	bool                                  active;
+	unsigned long long                    start;
+};
+
+/* -----------------------------------------------------------------------------
+ * Performance statistics
+ * ----------------------------------------------------------------------------- */
+
+extern std::atomic<bool> htree_stats_enabled;
+
+void htree_stats_add_phase(HTStatPhase phase, unsigned long long ns);
+void htree_stats_add_allocation(size_t size);
+void htree_stats_add_deallocation(void);
+const char* htree_stats_phase_name(HTStatPhase phase);
+
+inline bool htree_stats_active(void)
+{
+	return htree_stats_enabled.load(std::memory_order_relaxed);
+}
+
+/* times the enclosing block as a phase run, traces it as the document event */
+class HTreeStatsScope {
+public:
+	HTreeStatsScope(HTStatPhase phase, const HTDocument* doc):
+		phase(phase), active(htree_stats_active()), trace(htree_stats_phase_name(phase), doc)
+	{
+		if (active) {
+			start = std::chrono::steady_clock::now();
+		}
+	}
+	~HTreeStatsScope()
+	{
+		if (active) {
+			auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+			htree_stats_add_phase(phase, ns.count());
+		}
+	}
+	HTreeStatsScope(const HTreeStatsScope&) = delete;
+	HTreeStatsScope& operator=(const HTreeStatsScope&) = delete;
+
+private:
+	HTStatPhase                           phase;
+	bool                                  active;
+	std::chrono::steady_clock::time_point start;
+	HTreeTraceScope                       trace;
+};
+
+/* -----------------------------------------------------------------------------
+ * Memory allocation of the library objects
+ * ----------------------------------------------------------------------------- */
+
+extern std::atomic<const HTAllocator*> htree_global_allocator;
+extern thread_local const HTAllocator* htree_thread_allocator;
+
+/* the allocator for the new objects, NULL for malloc/free */
+inline const HTAllocator* htree_current_allocator(void)
+{
+	const HTAllocator* a = htree_thread_allocator;
+	if (!a) {
+		a = htree_global_allocator.load(std::memory_order_acquire);
+	}
+	return a && a->alloc ? a : NULL;
+}
+
+/* the blocks of a custom allocator start with its free callback, so they are released
+   by their owner whatever custom allocator is current; the malloc blocks have no header */
+struct alignas(std::max_align_t) HTreeBlockHeader {
+	void  (*release)(void* block, void* context);
+	void* context;
+};
+
+/* the estimated heap block size of the allocation: the allocator header
+   and the alignment of the common malloc implementations */
+inline size_t htree_alloc_block_size(size_t size)
+{
+	const size_t align = 2 * sizeof(size_t);
+	size_t block = size + sizeof(size_t);
+	if (block < 2 * align) {
+		block = 2 * align;
+	}
+	return (block + align - 1) & ~(align - 1);
+}
+
+inline HTreeBlockHeader* htree_block_header(void* ptr)
+{
+	return (HTreeBlockHeader*)ptr - 1;
+}
+
+inline void* htree_alloc_block(const HTAllocator* a, size_t size)
+{
+	if (!a) {
+		return malloc(size);
+	}
+	HTreeBlockHeader* h = (HTreeBlockHeader*)a->alloc(sizeof(HTreeBlockHeader) + size, a->context);
+	if (!h) return NULL;
+	h->release = a->free;
+	h->context = a->context;
+	return h + 1;
+}
+
+/* the block allocated while the allocator a (or any other custom one) was current */
+inline void htree_release_block(const HTAllocator* a, void* ptr)
+{
+	if (!a) {
+		free(ptr);
+		return ;
+	}
+	HTreeBlockHeader* h = htree_block_header(ptr);
+	h->release(h, h->context);
+}
+
+inline void* htree_alloc(size_t size)
+{
+	if (htree_stats_active()) {
+		htree_stats_add_allocation(size);
+	}
+	return htree_alloc_block(htree_current_allocator(), size);
+}
+
+inline void htree_free(void* ptr)
+{
+	if (!ptr) return ;
+	if (htree_stats_active()) {
+		htree_stats_add_deallocation();
+	}
+	htree_release_block(htree_current_allocator(), ptr);
+}
+
+/* grows the array of old_size bytes, an allocation is counted when the array is created */
+inline void* htree_realloc(void* ptr, size_t old_size, size_t size)
+{
+	const HTAllocator* a = htree_current_allocator();
+	if (!ptr && htree_stats_active()) {
+		htree_stats_add_allocation(size);
+	}
+	if (!a) {
+		return realloc(ptr, size);
+	}
+	void* p = htree_alloc_block(a, size);
+	if (p && ptr) {
+		memcpy(p, ptr, old_size);
+		htree_release_block(a, ptr);
+	}
+	return p;
+}
+
+/* the fixed size objects recycled by the document pool */
+typedef enum {
+	objPoint = 0,
+	objRect = 1,
+	objPolyline = 2,
+	objNode = 3,
+	objEdge = 4,
+	objKindsCount = 5
+} HTreeObjectKind;
+
+/* the block holding several objects, the object is released to the slab owner */
+typedef struct _HTreeSlab {
+	const char*             begin;
+	const char*             end;
+	void                  (*release)(struct _HTreeSlab* slab, void* ptr);
+} HTreeSlab;
+
+extern std::atomic<size_t> htree_slabs_count;
+
+/* the slab the object is placed in, NULL for the separately allocated objects */
+HTreeSlab* htree_find_slab(const void* ptr);
+
+extern thread_local struct _HTreePool* htree_thread_pool;
+
+void* htree_pool_alloc(struct _HTreePool* pool, HTreeObjectKind kind, size_t size);
+/* returns the size of the pool itself, the free objects are counted separately */
+size_t htree_pool_memory(const struct _HTreePool* pool, size_t* pooled);
+void htree_destroy_pool(struct _HTreePool* pool);
+
+/* the arena is one slab holding the objects one after another, every object releases
+   its share and the slab is freed with the last object */
+typedef struct _HTreeArena HTreeArena;
+
+/* the arena space taken by the object of the given size */
+inline size_t htree_arena_slot(size_t size)
+{
+	const size_t align = alignof(std::max_align_t);
+	return (size + align - 1) & ~(align - 1);
+}
+
+HTreeArena* htree_new_arena(size_t size);
+/* NULL if the arena is full */
+void* htree_arena_alloc(HTreeArena* arena, size_t size);
+/* the arena is filled, the slab is kept by the objects only */
+void htree_arena_done(HTreeArena* arena);
+
+inline void* htree_alloc_object(HTreeObjectKind kind, size_t size)
+{
+	if (htree_thread_pool) {
+		return htree_pool_alloc(htree_thread_pool, kind, size);
+	}
+	return htree_alloc(size);
+}
+
+/* the pooled objects return to the pool that allocated them whatever pool is current,
+   the arena objects release their share of the arena */
+inline void htree_free_object(void* ptr)
+{
+	if (!ptr) return ;
+	if (htree_slabs_count.load(std::memory_order_acquire) > 0) {
+		HTreeSlab* slab = htree_find_slab(ptr);
+		if (slab) {
+			slab->release(slab, ptr);
+			return ;
+		}
+	}
+	htree_free(ptr);
+}
+
+/* makes the allocator (and the document pool) current for the thread within the block */
+class HTreeAllocatorScope {
+public:
+	explicit HTreeAllocatorScope(const HTAllocator* allocator):
+		prev(htree_thread_allocator), prev_pool(htree_thread_pool)
+	{
+		htree_thread_allocator = allocator;
+		htree_thread_pool = NULL;
+	}
+	explicit HTreeAllocatorScope(const HTDocument* doc):
+		prev(htree_thread_allocator), prev_pool(htree_thread_pool)
+	{
+		htree_thread_allocator = &(doc->allocator);
+		htree_thread_pool = doc->pool;
+	}
+	~HTreeAllocatorScope()
+	{
+		htree_thread_allocator = prev;
+		htree_thread_pool = prev_pool;
+	}
+	HTreeAllocatorScope(const HTreeAllocatorScope&) = delete;
+	HTreeAllocatorScope& operator=(const HTreeAllocatorScope&) = delete;
+
+private:
+	const HTAllocator*                    prev;
+	struct _HTreePool*                    prev_pool;
+};
+
+/* STL allocator for the library containers */
+template<class T>
+class HTreeStlAllocator {
+public:
+	typedef T value_type;
+
+	HTreeStlAllocator() {}
+	template<class U> HTreeStlAllocator(const HTreeStlAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		void* p = htree_alloc(n * sizeof(T));
+		if (!p) {
+			throw std::bad_alloc();
+		}
+		return (T*)p;
+	}
+	void deallocate(T* p, size_t) { htree_free(p); }
+
+	template<class U> bool operator==(const HTreeStlAllocator<U>&) const { return true; }
+	template<class U> bool operator!=(const HTreeStlAllocator<U>&) const { return false; }
+};
+
+template<class T>
+using HTreeVector = std::vector<T, HTreeStlAllocator<T> >;
+
+template<class K, class V>
+using HTreeMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
+									HTreeStlAllocator<std::pair<const K, V> > >;
+
+template<class K>
+using HTreeSet = std::unordered_set<K, std::hash<K>, std::equal_to<K>, HTreeStlAllocator<K> >;
+
+/* the string copy allocated by the current allocator */
+int htree_copy_string(char** target, size_t* size, const char* source);
+
+/* -----------------------------------------------------------------------------
+ * Shared workers & asynchronous tasks
+ * ----------------------------------------------------------------------------- */
+
+/* runs task(i) for every i in [0, count) on up to threads participants (the calling
+   thread included, 0 means all the workers) and waits for the completion */
+void htree_parallel_for(size_t count, unsigned int threads, const std::function<void(size_t)>& task);
+
+/* the progress of the asynchronous task running on the thread */
+typedef struct {
+	std::atomic<bool>       cancelled;
+	std::atomic<size_t>     trees_processed;
+	std::atomic<size_t>     nodes_processed;
+} HTreeTaskState;
+
+extern thread_local HTreeTaskState* htree_thread_task;
+
+void htree_task_add_tree(HTreeTaskState* state, const HTree* tree);
+
+/* the per-tree loops stop on the cancellation, the document is discarded after that */
+inline bool htree_task_cancelled(void)
+{
+	return htree_thread_task && htree_thread_task->cancelled.load(std::memory_order_relaxed);
+}
+
+inline void htree_task_tree_done(const HTree* tree)
+{
+	if (htree_thread_task) {
+		htree_task_add_tree(htree_thread_task, tree);
+	}
+}
+
+#endif
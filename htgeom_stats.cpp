@@ -0,0 +1,99 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library: performance statistics
+ *
+ * Copyright (C) 2024-2025 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+
+#include <string.h>
+#include <atomic>
+
+#include "htgeom.h"
+#include "htgeom_internal.h"
+
+std::atomic<bool> htree_stats_enabled(false);
+
+static std::atomic<unsigned long long> stats_calls[statPhasesCount];
+static std::atomic<unsigned long long> stats_nanoseconds[statPhasesCount];
+static std::atomic<unsigned long long> stats_allocations(0);
+static std::atomic<unsigned long long> stats_allocated_bytes(0);
+static std::atomic<unsigned long long> stats_deallocations(0);
+
+static const char* stats_phase_names[statPhasesCount] = {
+	"absolute",
+	"borders",
+	"labels",
+	"bounding rect",
+	"format",
+	"reconstruct"
+};
+
+const char* htree_stats_phase_name(HTStatPhase phase)
+{
+	return stats_phase_names[phase];
+}
+
+void htree_stats_add_phase(HTStatPhase phase, unsigned long long ns)
+{
+	stats_calls[phase].fetch_add(1, std::memory_order_relaxed);
+	stats_nanoseconds[phase].fetch_add(ns, std::memory_order_relaxed);
+}
+
+void htree_stats_add_allocation(size_t size)
+{
+	stats_allocations.fetch_add(1, std::memory_order_relaxed);
+	stats_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void htree_stats_add_deallocation(void)
+{
+	stats_deallocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void htree_enable_stats(int enable)
+{
+	htree_stats_enabled.store(enable != 0);
+}
+
+int htree_get_stats(HTStats* stats)
+{
+	if (!stats) {
+		return HTREE_BAD_PARAMETER;
+	}
+	memset(stats, 0, sizeof(HTStats));
+	for (int i = 0; i < statPhasesCount; i++) {
+		stats->calls[i] = stats_calls[i].load(std::memory_order_relaxed);
+		stats->nanoseconds[i] = stats_nanoseconds[i].load(std::memory_order_relaxed);
+	}
+	stats->allocations = stats_allocations.load(std::memory_order_relaxed);
+	stats->allocated_bytes = stats_allocated_bytes.load(std::memory_order_relaxed);
+	stats->deallocations = stats_deallocations.load(std::memory_order_relaxed);
+	return HTREE_OK;
+}
+
+void htree_reset_stats(void)
+{
+	for (int i = 0; i < statPhasesCount; i++) {
+		stats_calls[i].store(0, std::memory_order_relaxed);
+		stats_nanoseconds[i].store(0, std::memory_order_relaxed);
+	}
+	stats_allocations.store(0, std::memory_order_relaxed);
+	stats_allocated_bytes.store(0, std::memory_order_relaxed);
+	stats_deallocations.store(0, std::memory_order_relaxed);
+}
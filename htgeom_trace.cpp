@@ -0,0 +1,140 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library: Chrome trace output
+ *
+ * Copyright (C) 2024-2025 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "htgeom.h"
+#include "htgeom_internal.h"
+
+typedef struct {
+	const char*             name;
+	unsigned long long      start, end;    /* ns from the trace start */
+	unsigned int            tid;
+	long                    trees, nodes, edges;
+} HTreeTraceEvent;
+
+std::atomic<bool> htree_trace_enabled(false);
+
+static std::mutex trace_mutex;
+static FILE* trace_file = NULL;
+static std::vector<HTreeTraceEvent> trace_events;
+static std::chrono::steady_clock::time_point trace_start;
+static std::atomic<unsigned int> trace_threads(0);
+
+unsigned long long htree_trace_clock(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+																trace_start).count();
+}
+
+static unsigned int htree_trace_thread_id(void)
+{
+	static thread_local unsigned int tid = ++trace_threads;
+	return tid;
+}
+
+static void htree_trace_count_nodes(const HTreeNode* nodes, long& count)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		count++;
+		htree_trace_count_nodes(node->children, count);
+	}
+}
+
+static void htree_trace_count_tree(const HTree* tree, HTreeTraceEvent& e)
+{
+	htree_trace_count_nodes(tree->nodes, e.nodes);
+	for (const HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+		e.edges++;
+	}
+}
+
+void htree_trace_add_event(const char* name, unsigned long long start, unsigned long long end,
+						   const HTDocument* doc, const HTree* tree)
+{
+	HTreeTraceEvent e = {name, start, end, htree_trace_thread_id(), -1, 0, 0};
+	if (tree) {
+		htree_trace_count_tree(tree, e);
+	} else if (doc) {
+		e.trees = 0;
+		for (const HTree* t = doc->trees; t; t = t->next) {
+			e.trees++;
+			htree_trace_count_tree(t, e);
+		}
+	}
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	if (trace_file) {
+		trace_events.push_back(e);
+	}
+}
+
+int htree_trace_start(const char* filename)
+{
+	if (!filename) {
+		return HTREE_BAD_PARAMETER;
+	}
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	if (trace_file) {
+		return HTREE_BAD_PARAMETER;
+	}
+	trace_file = fopen(filename, "w");
+	if (!trace_file) {
+		return HTREE_BAD_PARAMETER;
+	}
+	trace_events.clear();
+	trace_start = std::chrono::steady_clock::now();
+	htree_trace_enabled.store(true);
+	return HTREE_OK;
+}
+
+int htree_trace_stop(void)
+{
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	if (!trace_file) {
+		return HTREE_BAD_PARAMETER;
+	}
+	htree_trace_enabled.store(false);
+
+	fprintf(trace_file, "{\"traceEvents\":[\n");
+	for (size_t i = 0; i < trace_events.size(); i++) {
+		const HTreeTraceEvent& e = trace_events[i];
+		fprintf(trace_file,
+				"{\"name\":\"%s\",\"cat\":\"htgeom\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{",
+				e.name, e.start / 1000.0, (e.end - e.start) / 1000.0, e.tid);
+		if (e.trees >= 0) {
+			fprintf(trace_file, "\"trees\":%ld,", e.trees);
+		}
+		fprintf(trace_file, "\"nodes\":%ld,\"edges\":%ld}}%s\n", e.nodes, e.edges,
+				i + 1 < trace_events.size() ? "," : "");
+	}
+	fprintf(trace_file, "],\"displayTimeUnit\":\"ns\"}\n");
+	
+	fclose(trace_file);
+	trace_file = NULL;
+	trace_events.clear();
+	return HTREE_OK;
+}
@@ -22,9 +22,12 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include <iostream>
+#include <string_view>
 
 #include "htgeom.h"
+#include "htgeom_internal.h"
 #include "htgeom_types.h"
 
 #define MAX_STR_LEN	4096
@@ -43,7 +46,7 @@ int htree_copy_string(char** target, size_t* size, const char* source)
 	if (strsize > MAX_STR_LEN - 1) {
 		strsize = MAX_STR_LEN - 1;
 	}
-	target_str = (char*)malloc(strsize + 1);
+	target_str = (char*)htree_alloc(strsize + 1);
 	strncpy(target_str, source, strsize);
 	target_str[strsize] = 0;
 	*target = target_str;
@@ -55,16 +58,21 @@ int htree_copy_string(char** target, size_t* size, const char* source)
 
 HTreePoint* htree_new_point(void)
 {
-	HTreePoint* p = (HTreePoint*)malloc(sizeof(HTreePoint));
+	HTreePoint* p = (HTreePoint*)htree_alloc_object(objPoint, sizeof(HTreePoint));
 	memset(p, 0, sizeof(HTreePoint));
 	return p;
 }
 
 HTreePoint* htree_new_point_coord(float x, float y)
+{
+	return htree_new_point_coord_d(x, y);
+}
+
+HTreePoint* htree_new_point_coord_d(double x, double y)
 {
 	HTreePoint* p = htree_new_point();
-	p->x = x;
-	p->y = y;
+	p->x = (htree_coord_t)x;
+	p->y = (htree_coord_t)y;
 	return p;
 }
 
@@ -122,7 +130,7 @@ int htree_destroy_point(HTreePoint* p)
 	if (!p) {
 		return HTREE_BAD_PARAMETER;
 	}
-	free(p);
+	htree_free_object(p);
 	return HTREE_OK;
 }
 
@@ -145,26 +153,31 @@ HTreePoint* htree_rect_center_point(const HTreeRect* r, HTCoordFormat geometry_f
 	return point;
 }
 
-int htree_print_point(const HTreeRect* r)
+int htree_print_point(const HTreePoint* p)
 {
-	OSTREAM << r;
+	OSTREAM << p;
 	return HTREE_OK;
 }
 
 HTreeRect* htree_new_rect(void)
 {
-	HTreeRect* r = (HTreeRect*)malloc(sizeof(HTreeRect));
+	HTreeRect* r = (HTreeRect*)htree_alloc_object(objRect, sizeof(HTreeRect));
 	memset(r, 0, sizeof(HTreeRect));
 	return r;
 }
 
 HTreeRect* htree_new_rect_coord(float x, float y, float w, float h)
+{
+	return htree_new_rect_coord_d(x, y, w, h);
+}
+
+HTreeRect* htree_new_rect_coord_d(double x, double y, double w, double h)
 {
 	HTreeRect* r = htree_new_rect();
-	r->x = x;
-	r->y = y;
-	r->width = w;
-	r->height = h;
+	r->x = (htree_coord_t)x;
+	r->y = (htree_coord_t)y;
+	r->width = (htree_coord_t)w;
+	r->height = (htree_coord_t)h;
 	return r;
 }
 
@@ -232,7 +245,7 @@ int htree_round_rect(HTreeRect* r, unsigned int signs)
 int htree_destroy_rect(HTreeRect* r)
 {
 	if (!r) return HTREE_BAD_PARAMETER;
-	free(r);
+	htree_free_object(r);
 	return HTREE_OK;
 }
 
@@ -244,26 +257,34 @@ int htree_print_rect(const HTreeRect* r)
 
 HTreePolyline* htree_new_polyline(void)
 {
-	HTreePolyline* pl = (HTreePolyline*)malloc(sizeof(HTreePolyline));
+	HTreePolyline* pl = (HTreePolyline*)htree_alloc_object(objPolyline, sizeof(HTreePolyline));
 	memset(pl, 0, sizeof(HTreePolyline));
 	return pl;
 }
 
 HTreePolyline* htree_new_polyline_coord(float x, float y)
+{
+	return htree_new_polyline_coord_d(x, y);
+}
+
+HTreePolyline* htree_new_polyline_coord_d(double x, double y)
 {
 	HTreePolyline* pl = htree_new_polyline();
-	pl->point.x = x;
-	pl->point.y = y;	
+	pl->point.x = (htree_coord_t)x;
+	pl->point.y = (htree_coord_t)y;	
 	return pl;
 }
 
 void htree_polyline_add_point(HTreePolyline* pl, float x, float y)
+{
+	htree_polyline_add_point_d(pl, x, y);
+}
+
+void htree_polyline_add_point_d(HTreePolyline* pl, double x, double y)
 {
 	if (!pl) return ;
 	
-	HTreePolyline* new_point = htree_new_polyline();
-	new_point->point.x = x;
-	new_point->point.y = y;	
+	HTreePolyline* new_point = htree_new_polyline_coord_d(x, y);
 
 	if (pl->next) {
 		HTreePolyline* prev = pl->next;
@@ -341,14 +362,14 @@ int htree_destroy_polyline(HTreePolyline* polyline)
 	do {
 		pl = polyline;
 		polyline = polyline->next;
-		free(pl);
+		htree_free_object(pl);
 	} while (polyline);
 	return HTREE_OK;
 }
 
 HTreeNode* htree_new_node(HTNodeType node_type, const char* _id)
 {
-	HTreeNode* new_node = (HTreeNode*)malloc(sizeof(HTreeNode));
+	HTreeNode* new_node = (HTreeNode*)htree_alloc_object(objNode, sizeof(HTreeNode));
 	memset(new_node, 0, sizeof(HTreeNode));
 	htree_copy_string(&(new_node->id), &(new_node->id_len), _id);
 	new_node->type = node_type;
@@ -356,27 +377,37 @@ HTreeNode* htree_new_node(HTNodeType node_type, const char* _id)
 }
 
 void htree_node_set_rect(HTreeNode* node, float x, float y, float w, float h)
+{
+	htree_node_set_rect_d(node, x, y, w, h);
+}
+
+void htree_node_set_rect_d(HTreeNode* node, double x, double y, double w, double h)
 {
 	if (!node) return ;
 	if (node->rect) {
-		node->rect->x = x;
-		node->rect->y = y;
-		node->rect->width = w;
-		node->rect->height = h;		
+		node->rect->x = (htree_coord_t)x;
+		node->rect->y = (htree_coord_t)y;
+		node->rect->width = (htree_coord_t)w;
+		node->rect->height = (htree_coord_t)h;		
 	} else {
-		HTreeRect* r = htree_new_rect_coord(x, y, w, h);
+		HTreeRect* r = htree_new_rect_coord_d(x, y, w, h);
 		node->rect = r;
 	}
 }
 
 void htree_node_set_point(HTreeNode* node, float x, float y)
+{
+	htree_node_set_point_d(node, x, y);
+}
+
+void htree_node_set_point_d(HTreeNode* node, double x, double y)
 {
 	if (!node) return ;
 	if (node->point) {
-		node->point->x = x;
-		node->point->y = y;
+		node->point->x = (htree_coord_t)x;
+		node->point->y = (htree_coord_t)y;
 	} else {
-		HTreePoint* p = htree_new_point_coord(x, y);
+		HTreePoint* p = htree_new_point_coord_d(x, y);
 		node->point = p;
 	}
 }
@@ -456,16 +487,30 @@ HTreeNode* htree_find_node_by_id(HTreeNode* root, const char* id)
 
 static int htree_destroy_all_nodes(HTreeNode* node);
 
+/* the edges bound to the destroyed node keep the other end only */
+static void htree_detach_node_edges(HTreeNode* node)
+{
+	for (size_t i = 0; i < node->in_edges_count; i++) {
+		node->in_edges[i]->target = NULL;
+	}
+	for (size_t i = 0; i < node->out_edges_count; i++) {
+		node->out_edges[i]->source = NULL;
+	}
+}
+
 int htree_destroy_node(HTreeNode* node)
 {
 	if(node != NULL) {
-		if (node->id) free(node->id);
+		if (node->id) htree_free(node->id);
+		htree_detach_node_edges(node);
+		if (node->in_edges) htree_free(node->in_edges);
+		if (node->out_edges) htree_free(node->out_edges);
 		if (node->children) {
 			htree_destroy_all_nodes(node->children);
 		}
-		if (node->point) free(node->point);
-		if (node->rect) free(node->rect);
-		free(node);
+		if (node->point) htree_destroy_point(node->point);
+		if (node->rect) htree_destroy_rect(node->rect);
+		htree_free_object(node);
 	}
 	return HTREE_OK;
 }
@@ -485,7 +530,7 @@ static int htree_destroy_all_nodes(HTreeNode* node)
 
 HTreeEdge* htree_new_edge(const char* _id, const char* source_id, const char* target_id)
 {
-	HTreeEdge* new_edge = (HTreeEdge*)malloc(sizeof(HTreeEdge));
+	HTreeEdge* new_edge = (HTreeEdge*)htree_alloc_object(objEdge, sizeof(HTreeEdge));
 	memset(new_edge, 0, sizeof(HTreeEdge));
 	htree_copy_string(&(new_edge->id), &(new_edge->id_len), _id);
 	htree_copy_string(&(new_edge->source_id), &(new_edge->source_id_len), source_id);
@@ -494,22 +539,27 @@ HTreeEdge* htree_new_edge(const char* _id, const char* source_id, const char* ta
 }
 
 void htree_edge_set_points(HTreeEdge* edge, float source_x, float source_y, float target_x, float target_y)
+{
+	htree_edge_set_points_d(edge, source_x, source_y, target_x, target_y);
+}
+
+void htree_edge_set_points_d(HTreeEdge* edge, double source_x, double source_y, double target_x, double target_y)
 {
 	if (!edge) return ;
 
 	if (edge->source_point) {
-		edge->source_point->x = source_x;
-		edge->source_point->y = source_y;
+		edge->source_point->x = (htree_coord_t)source_x;
+		edge->source_point->y = (htree_coord_t)source_y;
 	} else {
-		HTreePoint* p = htree_new_point_coord(source_x, source_y);
+		HTreePoint* p = htree_new_point_coord_d(source_x, source_y);
 		edge->source_point = p;
 	}
 
 	if (edge->target_point) {
-		edge->target_point->x = target_x;
-		edge->target_point->y = target_y;
+		edge->target_point->x = (htree_coord_t)target_x;
+		edge->target_point->y = (htree_coord_t)target_y;
 	} else {
-		HTreePoint* p = htree_new_point_coord(target_x, target_y);
+		HTreePoint* p = htree_new_point_coord_d(target_x, target_y);
 		edge->target_point = p;
 	}
 }
@@ -550,9 +600,10 @@ int htree_destroy_edge(HTreeEdge* e)
 	if (!e) {
 		return HTREE_BAD_PARAMETER;
 	}
-	if (e->id) free(e->id);
-	if (e->source_id) free(e->source_id);
-	if (e->target_id) free(e->target_id);
+	htree_unbind_edge(e);
+	if (e->id) htree_free(e->id);
+	if (e->source_id) htree_free(e->source_id);
+	if (e->target_id) htree_free(e->target_id);
 //	if (e->abs_source_rect) free(e->abs_source_rect);
 //	if (e->abs_target_rect) free(e->abs_target_rect);
 	if (e->polyline) {
@@ -562,13 +613,13 @@ int htree_destroy_edge(HTreeEdge* e)
 	if (e->target_point) htree_destroy_point(e->target_point);
 	if (e->label_point) htree_destroy_point(e->label_point);
 	if (e->label_rect) htree_destroy_rect(e->label_rect);
-	free(e);
+	htree_free_object(e);
 	return HTREE_OK;	
 }
 
 HTree* htree_new_tree(void)
 {
-	HTree* tree = (HTree*)malloc(sizeof(HTree));
+	HTree* tree = (HTree*)htree_alloc(sizeof(HTree));
 	memset(tree, 0, sizeof(HTree));
 	return tree;
 }
@@ -585,6 +636,63 @@ void htree_add_node(HTree* tree, HTreeNode* n)
 	}
 }
 
+/* the index arrays capacity is the next power of two of the edges count */
+static void htree_edges_index_add(HTreeEdge*** index, size_t* count, HTreeEdge* e)
+{
+	size_t n = *count;
+	if (n == 0 || (n & (n - 1)) == 0) {
+		*index = (HTreeEdge**)htree_realloc(*index, sizeof(HTreeEdge*) * n, sizeof(HTreeEdge*) * (n ? 2 * n : 1));
+	}
+	(*index)[n] = e;
+	*count = n + 1;
+}
+
+/* the recently bound edges are at the end */
+static void htree_edges_index_remove(HTreeEdge** index, size_t* count, HTreeEdge* e)
+{
+	for (size_t i = *count; i-- > 0;) {
+		if (index[i] == e) {
+			memmove(index + i, index + i + 1, sizeof(HTreeEdge*) * (*count - i - 1));
+			(*count)--;
+			return ;
+		}
+	}
+}
+
+int htree_bind_edge(HTreeEdge* e, HTreeNode* source, HTreeNode* target)
+{
+	if (!e) {
+		return HTREE_BAD_PARAMETER;
+	}
+	/* the edge is removed from the previous endpoints' indexes */
+	htree_unbind_edge(e);
+	e->source = source;
+	e->target = target;
+	if (e->source) {
+		htree_edges_index_add(&(e->source->out_edges), &(e->source->out_edges_count), e);
+	}
+	if (e->target) {
+		htree_edges_index_add(&(e->target->in_edges), &(e->target->in_edges_count), e);
+	}
+	return HTREE_OK;
+}
+
+int htree_unbind_edge(HTreeEdge* e)
+{
+	if (!e) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (e->source) {
+		htree_edges_index_remove(e->source->out_edges, &(e->source->out_edges_count), e);
+		e->source = NULL;
+	}
+	if (e->target) {
+		htree_edges_index_remove(e->target->in_edges, &(e->target->in_edges_count), e);
+		e->target = NULL;
+	}
+	return HTREE_OK;
+}
+
 void htree_add_edge(HTree* tree, HTreeEdge* e)
 {
 	if (!tree || !e) return ;
@@ -595,6 +703,161 @@ void htree_add_edge(HTree* tree, HTreeEdge* e)
 	} else {
 		tree->edges = e;
 	}
+	/* the ends not bound yet are resolved by the ids among the tree nodes */
+	htree_bind_edge(e,
+					e->source ? e->source :
+					(e->source_id ? htree_find_node_by_id(tree->nodes, e->source_id) : NULL),
+					e->target ? e->target :
+					(e->target_id ? htree_find_node_by_id(tree->nodes, e->target_id) : NULL));
+}
+
+typedef HTreeMap<std::string_view, HTreeNode*> HTreeNodesIndex;
+
+static void htree_index_nodes(HTreeNode* nodes, HTreeNodesIndex& nodes_map)
+{
+	for (HTreeNode* node = nodes; node; node = node->next) {
+		if (node->id) {
+			nodes_map.insert(std::make_pair(std::string_view(node->id, node->id_len), node));
+		}
+		if (node->children) {
+			htree_index_nodes(node->children, nodes_map);
+		}
+	}
+}
+
+static HTreeNode* htree_lookup_node(const HTreeNodesIndex& nodes_map,
+									const char* id, size_t id_len)
+{
+	if (!id) {
+		return NULL;
+	}
+	auto i = nodes_map.find(std::string_view(id, id_len));
+	if (i == nodes_map.end()) {
+		return NULL;
+	}
+	return i->second;
+}
+
+int htree_build_adjacency(HTree* tree)
+{
+	HTreeNodesIndex nodes_map;
+	
+	if (!tree) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	htree_index_nodes(tree->nodes, nodes_map);
+
+	for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+		htree_bind_edge(edge,
+						edge->source ? edge->source :
+						htree_lookup_node(nodes_map, edge->source_id, edge->source_id_len),
+						edge->target ? edge->target :
+						htree_lookup_node(nodes_map, edge->target_id, edge->target_id_len));
+	}
+	
+	return HTREE_OK;
+}
+
+static size_t htree_number_nodes(HTreeNode* nodes, HTreeNode** index, size_t count)
+{
+	for (HTreeNode* node = nodes; node; node = node->next) {
+		if (index) {
+			index[count] = node;
+			node->index = count;
+		}
+		count = htree_number_nodes(node->children, index, count + 1);
+	}
+	return count;
+}
+
+int htree_build_nodes_index(HTree* tree)
+{
+	if (!tree) {
+		return HTREE_BAD_PARAMETER;
+	}
+	htree_drop_nodes_index(tree);
+	size_t count = htree_number_nodes(tree->nodes, NULL, 0);
+	if (count > 0) {
+		tree->nodes_index = (HTreeNode**)htree_alloc(sizeof(HTreeNode*) * count);
+		htree_number_nodes(tree->nodes, tree->nodes_index, 0);
+	}
+	tree->nodes_count = count;
+	return HTREE_OK;
+}
+
+int htree_drop_nodes_index(HTree* tree)
+{
+	if (!tree) {
+		return HTREE_BAD_PARAMETER;
+	}
+	if (tree->nodes_index) {
+		htree_free(tree->nodes_index);
+		tree->nodes_index = NULL;
+	}
+	tree->nodes_count = 0;
+	return HTREE_OK;
+}
+
+HTreeNode* htree_node_by_index(const HTree* tree, size_t index)
+{
+	if (!tree || index >= tree->nodes_count) {
+		return NULL;
+	}
+	return tree->nodes_index[index];
+}
+
+HTreeEdge* htree_new_edge_by_index(const HTree* tree, const char* id, size_t source, size_t target)
+{
+	HTreeNode* source_node = htree_node_by_index(tree, source);
+	HTreeNode* target_node = htree_node_by_index(tree, target);
+	if (!source_node || !target_node) {
+		return NULL;
+	}
+	HTreeEdge* edge = htree_new_edge(id, source_node->id, target_node->id);
+	htree_bind_edge(edge, source_node, target_node);
+	return edge;
+}
+
+/* the edge end id follows the node the end is bound to */
+static void htree_update_end_id(char** id, size_t* id_len, const char* node_id)
+{
+	if (*id && node_id && strcmp(*id, node_id) == 0) {
+		return ;
+	}
+	if (*id) {
+		htree_free(*id);
+	}
+	htree_copy_string(id, id_len, node_id);
+}
+
+int htree_resolve_edges_by_index(HTree* tree, const size_t* endpoints, size_t count)
+{
+	if (!tree || (!endpoints && count > 0)) {
+		return HTREE_BAD_PARAMETER;
+	}
+	/* check everything first, the edges are not changed on error */
+	size_t edges_count = 0;
+	for (HTreeEdge* edge = tree->edges; edge && edges_count < count; edge = edge->next) {
+		edges_count++;
+	}
+	if (edges_count < count) {
+		return HTREE_BAD_PARAMETER;
+	}
+	for (size_t i = 0; i < 2 * count; i++) {
+		if (endpoints[i] >= tree->nodes_count) {
+			return HTREE_NOT_FOUND;
+		}
+	}
+	HTreeEdge* edge = tree->edges;
+	for (size_t i = 0; i < count; i++, edge = edge->next) {
+		HTreeNode* source = tree->nodes_index[endpoints[2 * i]];
+		HTreeNode* target = tree->nodes_index[endpoints[2 * i + 1]];
+		htree_update_end_id(&(edge->source_id), &(edge->source_id_len), source->id);
+		htree_update_end_id(&(edge->target_id), &(edge->target_id_len), target->id);
+		htree_bind_edge(edge, source, target);
+	}
+	return HTREE_OK;
 }
 
 HTree* htree_copy_tree(const HTree* src)
@@ -645,21 +908,29 @@ HTree* htree_copy_tree(const HTree* src)
 		edge = dst->edges;
 
 		/* reconstruct source/target nodes */
+		HTreeNodesIndex nodes_map;
+		htree_index_nodes(dst->nodes, nodes_map);
 		while (edge) {
-			HTreeNode* source = htree_find_node_by_id(dst->nodes, edge->source_id);
-			HTreeNode* target = htree_find_node_by_id(dst->nodes, edge->target_id);
+			HTreeNode* source = htree_lookup_node(nodes_map, edge->source_id, edge->source_id_len);
+			HTreeNode* target = htree_lookup_node(nodes_map, edge->target_id, edge->target_id_len);
 			if (!source || !target) {
 				htree_destroy_tree(result);
 				return NULL;
 			}
-			edge->source = source;
-			edge->target = target;
+			htree_bind_edge(edge, source, target);
 			edge = edge->next;
 		}
+		if (src->nodes_index) {
+			htree_build_nodes_index(dst);
+		}
 
+		htree_task_tree_done(src);
+		if (htree_task_cancelled()) {
+			break;
+		}
 		src = src->next;
 	}
-	return dst;	
+	return result;
 }
 
 int htree_destroy_tree(HTree* tree)
@@ -678,9 +949,12 @@ int htree_destroy_tree(HTree* tree)
 				htree_destroy_edge(e);
 			} while (edge);
 		}
+		if (tree->nodes_index) {
+			htree_free(tree->nodes_index);
+		}
 		t = tree;
 		tree = tree->next;
-		free(t);
+		htree_free(t);
 	}
 	return HTREE_OK;
 }
@@ -755,8 +1029,12 @@ HTDocument* htree_new_document(HTCoordFormat _node_coord_format,
 							   HTCoordFormat _edge_pl_coord_format,
 							   HTEdgeFormat _edge_format)
 {
-	HTDocument* doc = (HTDocument*)malloc(sizeof(HTDocument));
+	HTDocument* doc = (HTDocument*)htree_alloc(sizeof(HTDocument));
 	memset(doc, 0, sizeof(HTDocument));
+	const HTAllocator* allocator = htree_current_allocator();
+	if (allocator) {
+		doc->allocator = *allocator;
+	}
 	doc->node_coord_format = _node_coord_format;
 	doc->edge_coord_format = _edge_coord_format;
 	doc->edge_pl_coord_format = _edge_pl_coord_format;
@@ -783,6 +1061,8 @@ HTDocument* htree_copy_document(const HTDocument* src)
 		return NULL;
 	}
 
+	HTreeAllocatorScope scope(src);
+	HTreeTraceScope trace("copy document", src);
 	dst = htree_new_document(src->node_coord_format,
 							 src->edge_coord_format,
 							 src->edge_pl_coord_format,
@@ -796,16 +1076,259 @@ HTDocument* htree_copy_document(const HTDocument* src)
 	return dst;
 }
 
+/* -----------------------------------------------------------------------------
+ * Compaction: every tree is moved to a single arena block, the nodes go in the
+ * depth-first order followed by the edges grouped by the source node; all the new
+ * objects are created before anything is freed, so the bindings between the trees
+ * are relocated too
+ * ----------------------------------------------------------------------------- */
+
+typedef HTreeMap<const HTreeNode*, HTreeNode*> HTreeNodesRelocation;
+typedef HTreeMap<const HTreeEdge*, HTreeEdge*> HTreeEdgesRelocation;
+
+typedef struct {
+	HTree*                  tree;
+	HTreeVector<HTreeNode*> nodes;              /* depth-first */
+	HTreeVector<HTreeEdge*> edges;              /* grouped by the source */
+	HTreeArena*             arena;
+} HTreeCompaction;
+
+static void htree_collect_nodes(HTreeNode* nodes, HTreeVector<HTreeNode*>& order)
+{
+	for (HTreeNode* node = nodes; node; node = node->next) {
+		order.push_back(node);
+		htree_collect_nodes(node->children, order);
+	}
+}
+
+static size_t htree_compaction_size(const HTreeCompaction& c)
+{
+	size_t size = 0;
+	for (const HTreeNode* node: c.nodes) {
+		size += htree_arena_slot(sizeof(HTreeNode));
+		if (node->rect) size += htree_arena_slot(sizeof(HTreeRect));
+		if (node->point) size += htree_arena_slot(sizeof(HTreePoint));
+	}
+	for (const HTreeEdge* edge: c.edges) {
+		size += htree_arena_slot(sizeof(HTreeEdge));
+		for (const HTreePolyline* pl = edge->polyline; pl; pl = pl->next) {
+			size += htree_arena_slot(sizeof(HTreePolyline));
+		}
+		if (edge->source_point) size += htree_arena_slot(sizeof(HTreePoint));
+		if (edge->target_point) size += htree_arena_slot(sizeof(HTreePoint));
+		if (edge->label_point) size += htree_arena_slot(sizeof(HTreePoint));
+		if (edge->label_rect) size += htree_arena_slot(sizeof(HTreeRect));
+	}
+	return size;
+}
+
+static void* htree_arena_copy(HTreeArena* arena, HTreeObjectKind kind, const void* src, size_t size)
+{
+	void* dst = arena ? htree_arena_alloc(arena, size) : NULL;
+	if (!dst) {
+		dst = htree_alloc_object(kind, size);
+	}
+	memcpy(dst, src, size);
+	return dst;
+}
+
+static HTreePolyline* htree_arena_copy_polyline(HTreeArena* arena, const HTreePolyline* src)
+{
+	HTreePolyline* dst = NULL;
+	HTreePolyline** link = &dst;
+	for (; src; src = src->next) {
+		*link = (HTreePolyline*)htree_arena_copy(arena, objPolyline, src, sizeof(HTreePolyline));
+		link = &((*link)->next);
+	}
+	return dst;
+}
+
+/* the copy keeps the power of two capacity of the index array */
+static HTreeEdge** htree_copy_edges_index(HTreeEdge** index, size_t count)
+{
+	if (!index || !count) {
+		return NULL;
+	}
+	size_t capacity = 1;
+	while (capacity < count) {
+		capacity *= 2;
+	}
+	HTreeEdge** result = (HTreeEdge**)htree_alloc(sizeof(HTreeEdge*) * capacity);
+	memcpy(result, index, sizeof(HTreeEdge*) * count);
+	return result;
+}
+
+static void htree_relocate_edges_index(HTreeEdge** index, size_t count, const HTreeEdgesRelocation& edges)
+{
+	for (size_t i = 0; i < count; i++) {
+		auto e = edges.find(index[i]);
+		if (e != edges.end()) {
+			index[i] = e->second;
+		}
+	}
+}
+
+static void htree_compaction_copy(HTreeCompaction& c, const HTreeMap<const HTreeNode*, size_t>& positions,
+								  HTreeNodesRelocation& new_nodes, HTreeEdgesRelocation& new_edges)
+{
+	c.arena = htree_new_arena(htree_compaction_size(c));
+	for (const HTreeNode* src: c.nodes) {
+		HTreeNode* dst = (HTreeNode*)htree_arena_copy(c.arena, objNode, src, sizeof(HTreeNode));
+		if (src->rect) dst->rect = (HTreeRect*)htree_arena_copy(c.arena, objRect, src->rect, sizeof(HTreeRect));
+		if (src->point) dst->point = (HTreePoint*)htree_arena_copy(c.arena, objPoint, src->point, sizeof(HTreePoint));
+		dst->in_edges = htree_copy_edges_index(src->in_edges, src->in_edges_count);
+		dst->out_edges = htree_copy_edges_index(src->out_edges, src->out_edges_count);
+		new_nodes[src] = dst;
+	}
+
+	auto source_position = [&](const HTreeNode* source) {
+		auto p = positions.find(source);
+		return p != positions.end() ? p->second : positions.size();
+	};
+	std::stable_sort(c.edges.begin(), c.edges.end(), [&](const HTreeEdge* a, const HTreeEdge* b) {
+		return source_position(a->source) < source_position(b->source);
+	});
+	for (const HTreeEdge* src: c.edges) {
+		HTreeEdge* dst = (HTreeEdge*)htree_arena_copy(c.arena, objEdge, src, sizeof(HTreeEdge));
+		dst->polyline = htree_arena_copy_polyline(c.arena, src->polyline);
+		if (src->source_point) {
+			dst->source_point = (HTreePoint*)htree_arena_copy(c.arena, objPoint, src->source_point, sizeof(HTreePoint));
+		}
+		if (src->target_point) {
+			dst->target_point = (HTreePoint*)htree_arena_copy(c.arena, objPoint, src->target_point, sizeof(HTreePoint));
+		}
+		if (src->label_point) {
+			dst->label_point = (HTreePoint*)htree_arena_copy(c.arena, objPoint, src->label_point, sizeof(HTreePoint));
+		}
+		if (src->label_rect) {
+			dst->label_rect = (HTreeRect*)htree_arena_copy(c.arena, objRect, src->label_rect, sizeof(HTreeRect));
+		}
+		new_edges[src] = dst;
+	}
+}
+
+/* the ids are moved to the new objects */
+static void htree_compaction_free(HTreeCompaction& c)
+{
+	for (HTreeNode* node: c.nodes) {
+		if (node->point) htree_destroy_point(node->point);
+		if (node->rect) htree_destroy_rect(node->rect);
+		if (node->in_edges) htree_free(node->in_edges);
+		if (node->out_edges) htree_free(node->out_edges);
+		htree_free_object(node);
+	}
+	for (HTreeEdge* edge: c.edges) {
+		if (edge->polyline) htree_destroy_polyline(edge->polyline);
+		if (edge->source_point) htree_destroy_point(edge->source_point);
+		if (edge->target_point) htree_destroy_point(edge->target_point);
+		if (edge->label_point) htree_destroy_point(edge->label_point);
+		if (edge->label_rect) htree_destroy_rect(edge->label_rect);
+		htree_free_object(edge);
+	}
+	if (c.arena) {
+		htree_arena_done(c.arena);
+	}
+}
+
+int htree_compact_document(HTDocument* doc)
+{
+	if (!doc) {
+		return HTREE_BAD_PARAMETER;
+	}
+
+	HTreeAllocatorScope scope(doc);
+	HTreeTraceScope trace("compact document", doc);
+	/* the offsets cache is keyed by the nodes */
+	int cached = doc->offsets_cache != NULL;
+	if (cached) {
+		htree_drop_offsets_cache(doc);
+	}
+
+	HTreeVector<HTreeCompaction> trees;
+	HTreeMap<const HTreeNode*, size_t> positions;
+	for (HTree* tree = doc->trees; tree; tree = tree->next) {
+		trees.push_back(HTreeCompaction{tree, {}, {}, NULL});
+		HTreeCompaction& c = trees.back();
+		htree_collect_nodes(tree->nodes, c.nodes);
+		for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+			c.edges.push_back(edge);
+		}
+		for (const HTreeNode* node: c.nodes) {
+			size_t position = positions.size();
+			positions[node] = position;
+		}
+	}
+	HTreeNodesRelocation new_nodes;
+	HTreeEdgesRelocation new_edges;
+	new_nodes.reserve(positions.size());
+	for (HTreeCompaction& c: trees) {
+		htree_compaction_copy(c, positions, new_nodes, new_edges);
+	}
+
+	auto relocate = [&](HTreeNode* node) {
+		auto n = new_nodes.find(node);
+		return n != new_nodes.end() ? n->second : node;
+	};
+	for (auto& n: new_nodes) {
+		HTreeNode* dst = n.second;
+		dst->parent = relocate(dst->parent);
+		dst->children = relocate(dst->children);
+		dst->next = relocate(dst->next);
+		htree_relocate_edges_index(dst->in_edges, dst->in_edges_count, new_edges);
+		htree_relocate_edges_index(dst->out_edges, dst->out_edges_count, new_edges);
+	}
+	for (auto& e: new_edges) {
+		HTreeEdge* dst = e.second;
+		dst->source = relocate(dst->source);
+		dst->target = relocate(dst->target);
+	}
+	for (HTreeCompaction& c: trees) {
+		HTree* tree = c.tree;
+		tree->nodes = relocate(tree->nodes);
+		/* the edges list follows the new order */
+		HTreeEdge** link = &(tree->edges);
+		for (const HTreeEdge* edge: c.edges) {
+			*link = new_edges[edge];
+			link = &((*link)->next);
+		}
+		*link = NULL;
+		for (size_t i = 0; i < tree->nodes_count; i++) {
+			tree->nodes_index[i] = relocate(tree->nodes_index[i]);
+		}
+	}
+
+	for (HTreeCompaction& c: trees) {
+		htree_compaction_free(c);
+	}
+	if (cached) {
+		htree_build_offsets_cache(doc);
+	}
+	return HTREE_OK;
+}
+
 int htree_destroy_document(HTDocument* doc)
 {
 	if (doc) {
+		HTAllocator allocator = doc->allocator;
+		if (htree_thread_allocator == &(doc->allocator) ||
+			(doc->pool && htree_thread_pool == doc->pool)) {
+			/* the document was the thread document */
+			htree_set_thread_document(NULL);
+		}
+		HTreeAllocatorScope scope(&allocator);
 		if (doc->trees) {
 			htree_destroy_tree(doc->trees);
 		}
 		if (doc->bounding_rect) {
 			htree_destroy_rect(doc->bounding_rect);
 		}
-		free(doc);
+		if (doc->offsets_cache) {
+			htree_drop_offsets_cache(doc);
+		}
+		if (doc->pool) {
+			htree_destroy_pool(doc->pool);
+		}
+		htree_free(doc);
 	}
 	return HTREE_OK;
 }
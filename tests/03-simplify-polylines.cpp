@@ -0,0 +1,54 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+#include "htgeom.h"
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+
+	for (int i = 0; i < 2; i++) {
+		HTree* tree = htree_new_tree();
+		htree_add_tree(doc, tree);
+		HTreeNode* node0 = htree_new_node(htSimpleNode, i ? "t1-node-0" : "t0-node-0");
+		htree_node_set_rect(node0, 0, 0, 100, 100);
+		htree_add_node(tree, node0);
+		HTreeNode* node1 = htree_new_node(htSimpleNode, i ? "t1-node-1" : "t0-node-1");
+		htree_node_set_rect(node1, 400, 400, 100, 100);
+		htree_add_node(tree, node1);
+
+		HTreeEdge* edge = htree_new_edge(i ? "t1-e" : "t0-e", node0->id, node1->id);
+		htree_edge_set_points(edge, 100, 50, 450, 400);
+		edge->polyline = htree_new_polyline_coord(200, 50);
+		htree_polyline_add_point(edge->polyline, 200.5, 50.2);
+		htree_polyline_add_point(edge->polyline, 300, 50);
+		htree_polyline_add_point(edge->polyline, 450, 50);
+		htree_polyline_add_point(edge->polyline, 450, 200);
+		htree_polyline_add_point(edge->polyline, 450.3, 300);
+		htree_add_edge(tree, edge);
+	}
+
+	htree_simplify_document_polylines(doc, 1.0, 2);
+	
+	htree_print_document(doc);
+	htree_destroy_document(doc);
+	return 0;
+}
@@ -0,0 +1,78 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = htree_new_node(htCompositeNode, "parent");
+	htree_node_set_rect(parent, 10, 10, 500, 300);
+	htree_add_node(tree, parent);
+	HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+	htree_node_set_rect(node0, 60, 160, 150, 100);
+	htree_add_child_node(parent, node0);
+	HTreeNode* node1 = htree_new_node(htCompositeNode, "node-1");
+	htree_node_set_rect(node1, 310, 60, 200, 150);
+	htree_add_child_node(parent, node1);
+	HTreeNode* node11 = htree_new_node(htSimpleNode, "node-1-1");
+	htree_node_set_rect(node11, 330, 80, 110, 70);
+	htree_add_child_node(node1, node11);
+
+	HTreeEdge* edge = htree_new_edge("e-0-11", "node-0", "node-1-1");
+	htree_edge_set_points(edge, 210, 210, 330, 115);
+	edge->polyline = htree_new_polyline_coord(270, 210);
+	htree_polyline_add_point(edge->polyline, 270, 115);
+	htree_add_edge(tree, edge);
+
+	/* resolve the edges' source & target nodes */
+	HTDocument* src = htree_copy_document(doc);
+	htree_destroy_document(doc);
+	htree_build_bounding_rect(src, &(src->bounding_rect));
+	
+	HTDocument* dst = NULL;
+	htree_convert_document_geometry_copy(src, &dst, coordLeftTop, coordLocalCenter, coordLeftTop, edgeCenter);
+	htree_print_document(src);
+	htree_print_document(dst);
+
+	HTreeRect rect;
+	HTreePoint source, target;
+	htree_build_offsets_cache(dst);
+	htree_node_absolute_rect(dst, htree_find_node_by_id(dst->trees->nodes, "node-1-1"), &rect);
+	htree_print_rect(&rect);
+	htree_edge_absolute_points(dst, dst->trees->edges, &source, &target, NULL);
+	printf("\n");
+	htree_print_point(&source);
+	htree_print_point(&target);
+	printf("\n");
+	
+	htree_convert_document_geometry_copy(src, &dst, coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	htree_print_document(dst);
+	
+	htree_destroy_document(dst);
+	htree_destroy_document(src);
+	return 0;
+}
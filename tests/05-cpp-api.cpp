@@ -0,0 +1,83 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include "htgeom.hpp"
+
+static_assert(std::is_nothrow_move_constructible<htree::Node>::value &&
+			  std::is_nothrow_move_assignable<htree::Document>::value,
+			  "the handles should be moved without exceptions");
+
+static void print_nodes(const htree::NodeList& nodes, int level)
+{
+	for (HTreeNode& node : nodes) {
+		std::cout << std::string(level * 2, ' ') << node.id <<
+			" in: " << htree::in_edges(node).size() <<
+			" out: " << htree::out_edges(node).size() << std::endl;
+		print_nodes(htree::children(node), level + 1);
+	}
+}
+
+int main()
+{
+	htree::Document doc(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+
+	htree::Tree tree = htree::Tree::create();
+	htree::Node parent(htCompositeNode, "parent");
+	parent.set_rect(10, 10, 500, 300);
+	htree::Node node0(htSimpleNode, "node-0");
+	node0.set_rect(60, 160, 150, 100);
+	parent.add_child(std::move(node0));
+	htree::Node node1(htSimpleNode, "node-1");
+	node1.set_rect(310, 60, 200, 150);
+	parent.add_child(std::move(node1));
+	tree.add(std::move(parent));
+
+	htree::Edge edge("e-0-1", "node-0", "node-1");
+	edge.set_points(210, 210, 310, 135);
+	htree_polyline_add_point(edge->polyline = htree_new_polyline_coord(260, 210), 260, 135);
+	tree.add(std::move(edge));
+	tree.add(htree::Edge("e-1-0", "node-1", "node-0"));
+	tree.build_adjacency();
+	
+	doc.add(std::move(tree));
+	doc.build_bounding_rect();
+
+	for (HTree& t : doc.trees()) {
+		print_nodes(htree::nodes(t), 0);
+		for (HTreeEdge& e : htree::edges(t)) {
+			std::cout << e.id << ":";
+			for (HTreePoint& p : htree::polyline(e)) {
+				std::cout << " " << p.x << "," << p.y;
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	htree::Document converted = doc.convert_copy(coordLeftTop, coordLeftTop, coordLeftTop, edgeBorder);
+	htree::Document moved(std::move(converted));
+	moved.print();
+	doc.print();
+	return 0;
+}
@@ -0,0 +1,69 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+int main()
+{
+	HTStats stats;
+
+	htree_reset_stats();
+	htree_enable_stats(1);
+	
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = htree_new_node(htCompositeNode, "parent");
+	htree_node_set_rect(parent, 10, 10, 500, 300);
+	htree_add_node(tree, parent);
+	HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+	htree_node_set_rect(node0, 60, 160, 150, 100);
+	htree_add_child_node(parent, node0);
+	HTreeNode* node1 = htree_new_node(htSimpleNode, "node-1");
+	htree_add_child_node(parent, node1);
+	HTreeEdge* edge = htree_new_edge("e-0-1", "node-0", "node-1");
+	htree_add_edge(tree, edge);
+	htree_build_adjacency(tree);
+
+	htree_reconstruct_document_geometry(doc, 0);
+	htree_convert_document_geometry(doc, coordLeftTop, coordLocalCenter, coordLeftTop, edgeCenter);
+	htree_convert_document_geometry(doc, coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	htree_destroy_document(doc);
+
+	htree_enable_stats(0);
+	htree_get_stats(&stats);
+	for (int i = 0; i < statPhasesCount; i++) {
+		printf("phase %d: %llu runs\n", i, stats.calls[i]);
+	}
+	printf("allocations: %s\n", stats.allocations > 0 ? "counted" : "none");
+	printf("all freed: %s\n", stats.allocations == stats.deallocations ? "yes" : "no");
+
+	htree_reset_stats();
+	doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	htree_destroy_document(doc);
+	htree_get_stats(&stats);
+	printf("disabled: %llu allocations\n", stats.allocations);
+	
+	return 0;
+}
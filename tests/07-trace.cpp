@@ -0,0 +1,70 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include "htgeom.h"
+
+#define TRACE_FILE "07-trace.json"
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordLeftTop, coordLocalCenter, coordLeftTop, edgeCenter);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+	htree_node_set_rect(node0, 0, 0, 100, 50);
+	htree_add_node(tree, node0);
+	HTreeNode* node1 = htree_new_node(htSimpleNode, "node-1");
+	htree_node_set_rect(node1, 200, 0, 100, 50);
+	htree_add_node(tree, node1);
+	HTreeEdge* edge = htree_new_edge("e-0-1", "node-0", "node-1");
+	htree_edge_set_points(edge, 0, 0, 0, 0);
+	htree_add_edge(tree, edge);
+	htree_build_adjacency(tree);
+	htree_build_bounding_rect(doc, &(doc->bounding_rect));
+
+	printf("start: %d\n", htree_trace_start(TRACE_FILE));
+	printf("second start: %d\n", htree_trace_start(TRACE_FILE));
+	htree_convert_document_geometry(doc, coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	printf("stop: %d\n", htree_trace_stop());
+	printf("second stop: %d\n", htree_trace_stop());
+	htree_destroy_document(doc);
+
+	FILE* f = fopen(TRACE_FILE, "r");
+	if (!f) {
+		return 1;
+	}
+	char line[1024];
+	while (fgets(line, sizeof(line), f)) {
+		const char* name = strstr(line, "{\"name\":\"");
+		if (name) {
+			name += strlen("{\"name\":\"");
+			const char* args = strstr(line, "\"args\":");
+			printf("%.*s %s", (int)(strchr(name, '"') - name), name, args ? args : "\n");
+		}
+	}
+	fclose(f);
+	remove(TRACE_FILE);
+	return 0;
+}
@@ -0,0 +1,64 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+static void print_usage(const HTDocument* doc)
+{
+	HTMemoryUsage u;
+	htree_document_memory_usage(doc, &u);
+	printf("nodes: %zu, edges: %zu, geometry: %zu, polylines: %zu, strings: %zu, indexes: %zu, other: %zu, total: %zu\n",
+		   u.nodes, u.edges, u.geometry, u.polylines, u.strings, u.indexes, u.other, u.total);
+}
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	print_usage(doc);
+
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = htree_new_node(htCompositeNode, "parent");
+	htree_node_set_rect(parent, 10, 10, 500, 300);
+	htree_add_node(tree, parent);
+	HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+	htree_node_set_rect(node0, 60, 160, 150, 100);
+	htree_add_child_node(parent, node0);
+	HTreeNode* node1 = htree_new_node(htPoint, "node-1");
+	htree_node_set_point(node1, 310, 60);
+	htree_add_child_node(parent, node1);
+	HTreeEdge* edge = htree_new_edge("e-0-1", "node-0", "node-1");
+	htree_edge_set_points(edge, 210, 210, 310, 60);
+	edge->polyline = htree_new_polyline_coord(270, 210);
+	htree_polyline_add_point(edge->polyline, 270, 60);
+	htree_add_edge(tree, edge);
+	print_usage(doc);
+
+	htree_build_adjacency(tree);
+	htree_build_bounding_rect(doc, &(doc->bounding_rect));
+	print_usage(doc);
+
+	htree_destroy_document(doc);
+	return 0;
+}
@@ -0,0 +1,142 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "htgeom.h"
+
+typedef struct {
+	const char* name;
+	long        allocated;
+	long        freed;
+} Counter;
+
+static void* counting_alloc(size_t size, void* context)
+{
+	((Counter*)context)->allocated++;
+	return malloc(size);
+}
+
+static void counting_free(void* ptr, void* context)
+{
+	((Counter*)context)->freed++;
+	free(ptr);
+}
+
+static HTDocument* build_document(void)
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	for (int i = 0; i < 3; i++) {
+		HTree* tree = htree_new_tree();
+		htree_add_tree(doc, tree);
+		HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+		htree_node_set_rect(node0, 60, 160, 150, 100);
+		htree_add_node(tree, node0);
+		HTreeNode* node1 = htree_new_node(htSimpleNode, "node-1");
+		htree_node_set_rect(node1, 310, 60, 200, 150);
+		htree_add_node(tree, node1);
+		HTreeEdge* edge = htree_new_edge("e-0-1", "node-0", "node-1");
+		htree_edge_set_points(edge, 210, 210, 310, 135);
+		edge->polyline = htree_new_polyline_coord(260, 210);
+		htree_polyline_add_point(edge->polyline, 260, 200);
+		htree_polyline_add_point(edge->polyline, 260, 135);
+		htree_add_edge(tree, edge);
+		htree_build_adjacency(tree);
+	}
+	return doc;
+}
+
+static void process_document(HTDocument* doc)
+{
+	htree_build_bounding_rect(doc, &(doc->bounding_rect));
+	htree_convert_document_geometry(doc, coordLeftTop, coordLocalCenter, coordLeftTop, edgeCenter);
+	htree_build_offsets_cache(doc);
+	htree_convert_document_geometry(doc, coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	htree_simplify_document_polylines(doc, 1.0, 3);
+}
+
+static void print_counter(const Counter* c)
+{
+	printf("%s: %s, %s\n", c->name,
+		   c->allocated > 0 ? "used" : "not used",
+		   c->allocated == c->freed ? "balanced" : "unbalanced");
+}
+
+int main()
+{
+	Counter global = {"global", 0, 0};
+	Counter request = {"request", 0, 0};
+	HTAllocator global_allocator = {counting_alloc, counting_free, &global};
+	HTAllocator request_allocator = {counting_alloc, counting_free, &request};
+	HTAllocator bad_allocator = {counting_alloc, NULL, NULL};
+
+	printf("bad allocator: %d\n", htree_set_allocator(&bad_allocator));
+	
+	htree_set_allocator(&global_allocator);
+	HTDocument* doc = build_document();
+	process_document(doc);
+	htree_destroy_document(doc);
+	print_counter(&global);
+
+	/* the document is built with the request allocator and keeps it */
+	htree_set_thread_allocator(&request_allocator);
+	doc = build_document();
+	htree_set_thread_allocator(NULL);
+	long global_allocated = global.allocated;
+	process_document(doc);
+	HTDocument* copy = NULL;
+	htree_convert_document_geometry_copy(doc, &copy, coordLeftTop, coordLocalCenter, coordLeftTop, edgeCenter);
+	htree_destroy_document(doc);
+	htree_destroy_document(copy);
+	print_counter(&request);
+	printf("global after the request: %s\n", global.allocated == global_allocated ? "not used" : "used");
+
+	/* the objects are freed by their own allocator whatever allocator is current */
+	Counter loose = {"loose tree", 0, 0};
+	HTAllocator loose_allocator = {counting_alloc, counting_free, &loose};
+	htree_set_thread_allocator(&loose_allocator);
+	HTree* tree = htree_new_tree();
+	HTreeNode* node = htree_new_node(htSimpleNode, "node-0");
+	htree_node_set_rect(node, 60, 160, 150, 100);
+	htree_add_node(tree, node);
+	htree_set_thread_allocator(NULL);
+	long global_freed = global.freed;
+	htree_destroy_tree(tree);
+	print_counter(&loose);
+	printf("global on the loose tree: %s\n", global.freed == global_freed ? "not used" : "used");
+
+	/* the thread allocator is active again after the thread document */
+	HTAllocator current;
+	htree_set_thread_allocator(&request_allocator);
+	doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	htree_set_thread_document(doc);
+	htree_destroy_document(doc);
+	htree_get_allocator(&current);
+	printf("thread allocator after the document: %s\n", current.context == &request ? "kept" : "lost");
+	htree_set_thread_allocator(NULL);
+
+	htree_set_allocator(NULL);
+	htree_get_allocator(&current);
+	printf("default allocator: %s\n", current.alloc ? "custom" : "malloc");
+	return 0;
+}
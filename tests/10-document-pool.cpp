@@ -0,0 +1,126 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "htgeom.h"
+
+static void* failing_alloc(size_t size, void* context)
+{
+	return *(int*)context ? NULL : malloc(size);
+}
+
+static void failing_free(void* ptr, void*)
+{
+	free(ptr);
+}
+
+static void build_tree(HTree* tree)
+{
+	for (int i = 0; i < 10; i++) {
+		char id[16];
+		snprintf(id, sizeof(id), "n%d", i);
+		HTreeNode* node = htree_new_node(htSimpleNode, id);
+		htree_node_set_rect(node, i * 100, 0, 50, 50);
+		htree_add_node(tree, node);
+	}
+	for (int i = 0; i < 9; i++) {
+		char id[16], source[16], target[16];
+		snprintf(id, sizeof(id), "e%d", i);
+		snprintf(source, sizeof(source), "n%d", i);
+		snprintf(target, sizeof(target), "n%d", i + 1);
+		HTreeEdge* edge = htree_new_edge(id, source, target);
+		htree_edge_set_points(edge, 50, 25, 0, 25);
+		edge->polyline = htree_new_polyline_coord(i * 100 + 75, 25);
+		htree_add_edge(tree, edge);
+	}
+}
+
+int main()
+{
+	HTStats stats;
+	HTMemoryUsage usage;
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+
+	printf("trim without pool: %d\n", htree_trim_document_pool(doc));
+	htree_enable_document_pool(doc);
+	htree_set_thread_document(doc);
+	htree_enable_stats(1);
+
+	size_t allocations[3];
+	for (int round = 0; round < 3; round++) {
+		HTree* tree = htree_new_tree();
+		build_tree(tree);
+		htree_destroy_tree(tree);
+		htree_get_stats(&stats);
+		allocations[round] = stats.allocations;
+	}
+	printf("first round allocations: %s\n", allocations[0] > 0 ? "yes" : "no");
+	printf("objects reused: %s\n",
+		   allocations[2] - allocations[1] < allocations[0] ? "yes" : "no");
+
+	htree_document_memory_usage(doc, &usage);
+	printf("pooled after rounds: %s\n", usage.pooled > 0 ? "yes" : "no");
+	htree_trim_document_pool(doc);
+	htree_document_memory_usage(doc, &usage);
+	printf("pooled after trim: %zu\n", usage.pooled);
+
+	/* the objects return to the pool of their document whatever document is current */
+	HTDocument* other = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	htree_enable_document_pool(other);
+	htree_set_thread_document(other);
+	HTree* tree = htree_new_tree();
+	build_tree(tree);
+	htree_set_thread_document(doc);
+	htree_destroy_tree(tree);
+	htree_document_memory_usage(doc, &usage);
+	printf("pooled by the current document: %zu\n", usage.pooled);
+	htree_document_memory_usage(other, &usage);
+	printf("pooled by the owner: %s\n", usage.pooled > 0 ? "yes" : "no");
+
+	/* the objects outliving their document are freed when destroyed */
+	htree_set_thread_document(other);
+	tree = htree_new_tree();
+	build_tree(tree);
+	htree_set_thread_document(doc);
+	htree_destroy_document(other);
+	htree_destroy_tree(tree);
+
+	htree_get_stats(&stats);
+	printf("balanced: %s\n", stats.allocations == stats.deallocations ? "yes" : "no");
+
+	htree_enable_stats(0);
+	htree_destroy_document(doc);
+
+	/* the pool is not created when the document allocator fails */
+	int fail = 0;
+	HTAllocator failing_allocator = {failing_alloc, failing_free, &fail};
+	htree_set_thread_allocator(&failing_allocator);
+	doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	htree_set_thread_allocator(NULL);
+	fail = 1;
+	printf("failed pool: %d\n", htree_enable_document_pool(doc));
+	fail = 0;
+	printf("pool after failure: %s\n", doc->pool ? "yes" : "no");
+	htree_destroy_document(doc);
+	return 0;
+}
@@ -0,0 +1,151 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+#define DOCUMENTS 64
+
+static HTDocument* build_document(int n)
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = htree_new_node(htCompositeNode, "parent");
+	htree_node_set_rect(parent, 10 + n, 10, 500, 300);
+	htree_add_node(tree, parent);
+	HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+	htree_node_set_rect(node0, 60 + n, 160, 150, 100);
+	htree_add_child_node(parent, node0);
+	HTreeNode* node1 = htree_new_node(htSimpleNode, "node-1");
+	htree_node_set_rect(node1, 310 + n, 60, 200, 150);
+	htree_add_child_node(parent, node1);
+	HTreeEdge* edge = htree_new_edge("e-0-1", "node-0", "node-1");
+	htree_edge_set_points(edge, 210 + n, 210, 310 + n, 135);
+	edge->polyline = htree_new_polyline_coord(260 + n, 210);
+	htree_polyline_add_point(edge->polyline, 260 + n, 135);
+	htree_add_edge(tree, edge);
+	htree_build_adjacency(tree);
+	return doc;
+}
+
+static int same_rect(const HTreeRect* a, const HTreeRect* b)
+{
+	if (!a || !b) return a == b;
+	return a->x == b->x && a->y == b->y && a->width == b->width && a->height == b->height;
+}
+
+static int same_point(const HTreePoint* a, const HTreePoint* b)
+{
+	if (!a || !b) return a == b;
+	return a->x == b->x && a->y == b->y;
+}
+
+static int same_nodes(const HTreeNode* a, const HTreeNode* b)
+{
+	for (; a && b; a = a->next, b = b->next) {
+		if (!same_rect(a->rect, b->rect) || !same_point(a->point, b->point) ||
+			!same_nodes(a->children, b->children)) {
+			return 0;
+		}
+	}
+	return a == b;
+}
+
+static int same_documents(const HTDocument* a, const HTDocument* b)
+{
+	const HTree* ta = a->trees;
+	const HTree* tb = b->trees;
+	for (; ta && tb; ta = ta->next, tb = tb->next) {
+		if (!same_nodes(ta->nodes, tb->nodes)) return 0;
+		const HTreeEdge* ea = ta->edges;
+		const HTreeEdge* eb = tb->edges;
+		for (; ea && eb; ea = ea->next, eb = eb->next) {
+			if (!same_point(ea->source_point, eb->source_point) ||
+				!same_point(ea->target_point, eb->target_point)) {
+				return 0;
+			}
+			const HTreePolyline* pa = ea->polyline;
+			const HTreePolyline* pb = eb->polyline;
+			for (; pa && pb; pa = pa->next, pb = pb->next) {
+				if (!same_point(&(pa->point), &(pb->point))) return 0;
+			}
+			if (pa || pb) return 0;
+		}
+		if (ea || eb) return 0;
+	}
+	return ta == tb && a->node_coord_format == b->node_coord_format &&
+		a->edge_format == b->edge_format;
+}
+
+int main()
+{
+	HTConvertJob jobs[DOCUMENTS];
+	HTDocument* expected[DOCUMENTS];
+
+	printf("no jobs: %d\n", htree_convert_documents_geometry(NULL, 0, 0));
+	
+	for (int i = 0; i < DOCUMENTS; i++) {
+		HTCoordFormat format = (i % 2) ? coordLeftTop : coordLocalCenter;
+		HTEdgeFormat edge_format = (i % 3) ? edgeCenter : edgeBorder;
+		jobs[i].doc = build_document(i);
+		jobs[i].node_coord_format = format;
+		jobs[i].edge_coord_format = format;
+		jobs[i].edge_pl_coord_format = format;
+		jobs[i].edge_format = edge_format;
+		jobs[i].result = -1;
+		expected[i] = build_document(i);
+		htree_convert_document_geometry(expected[i], format, format, format, edge_format);
+	}
+
+	printf("batch: %d\n", htree_convert_documents_geometry(jobs, DOCUMENTS, 4));
+	int ok = 1;
+	for (int i = 0; i < DOCUMENTS; i++) {
+		if (jobs[i].result != 0 || !same_documents(jobs[i].doc, expected[i])) {
+			printf("document %d differs\n", i);
+			ok = 0;
+		}
+	}
+	printf("same as sequential: %s\n", ok ? "yes" : "no");
+
+	/* back to absolute on all the workers */
+	for (int i = 0; i < DOCUMENTS; i++) {
+		jobs[i].node_coord_format = coordAbsolute;
+		jobs[i].edge_coord_format = coordAbsolute;
+		jobs[i].edge_pl_coord_format = coordAbsolute;
+		jobs[i].edge_format = edgeBorder;
+	}
+	printf("batch to absolute: %d\n", htree_convert_documents_geometry(jobs, DOCUMENTS, 0));
+	
+	HTDocument* doc = jobs[1].doc;
+	jobs[1].doc = NULL;
+	int res = htree_convert_documents_geometry(jobs, 3, 2);
+	printf("batch with a bad job: %d, job statuses %d %d %d\n", res,
+		   jobs[0].result, jobs[1].result, jobs[2].result);
+	jobs[1].doc = doc;
+	
+	for (int i = 0; i < DOCUMENTS; i++) {
+		htree_destroy_document(jobs[i].doc);
+		htree_destroy_document(expected[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,137 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+static HTDocument* build_document(int trees)
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	for (int i = 0; i < trees; i++) {
+		HTree* tree = htree_new_tree();
+		htree_add_tree(doc, tree);
+		HTreeNode* parent = htree_new_node(htCompositeNode, "parent");
+		htree_node_set_rect(parent, 10 + i, 10, 500, 300);
+		htree_add_node(tree, parent);
+		HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+		htree_node_set_rect(node0, 60 + i, 160, 150, 100);
+		htree_add_child_node(parent, node0);
+		HTreeNode* node1 = htree_new_node(htSimpleNode, "node-1");
+		htree_node_set_rect(node1, 310 + i, 60, 200, 150);
+		htree_add_child_node(parent, node1);
+		HTreeEdge* edge = htree_new_edge("e-0-1", "node-0", "node-1");
+		htree_edge_set_points(edge, 210 + i, 210, 310 + i, 135);
+		htree_add_edge(tree, edge);
+		htree_build_adjacency(tree);
+	}
+	return doc;
+}
+
+static int same_nodes(const HTreeNode* a, const HTreeNode* b)
+{
+	for (; a && b; a = a->next, b = b->next) {
+		if ((a->rect == NULL) != (b->rect == NULL)) return 0;
+		if (a->rect && (a->rect->x != b->rect->x || a->rect->y != b->rect->y ||
+						a->rect->width != b->rect->width || a->rect->height != b->rect->height)) {
+			return 0;
+		}
+		if (!same_nodes(a->children, b->children)) return 0;
+	}
+	return a == b;
+}
+
+static int same_documents(const HTDocument* a, const HTDocument* b)
+{
+	const HTree* ta = a->trees;
+	const HTree* tb = b->trees;
+	for (; ta && tb; ta = ta->next, tb = tb->next) {
+		if (!same_nodes(ta->nodes, tb->nodes)) return 0;
+	}
+	return ta == tb && a->node_coord_format == b->node_coord_format;
+}
+
+int main()
+{
+	HTProgress progress;
+	HTDocument* doc = build_document(3);
+	HTDocument* expected = build_document(3);
+	htree_convert_document_geometry(expected, coordLeftTop, coordLocalCenter, coordLeftTop, edgeCenter);
+
+	HTAsyncTask* task = htree_convert_document_geometry_async(doc, coordLeftTop, coordLocalCenter,
+															  coordLeftTop, edgeCenter);
+	printf("convert: %d\n", htree_task_wait(task, -1));
+	htree_task_progress(task, &progress);
+	printf("progress: %zu trees, %zu nodes, %zu trees processed, %zu nodes processed, finished %d\n",
+		   progress.trees, progress.nodes, progress.trees_processed, progress.nodes_processed,
+		   progress.finished);
+	printf("same as blocking: %s\n", same_documents(doc, expected) ? "yes" : "no");
+	printf("wait again: %d\n", htree_task_wait(task, 0));
+	htree_destroy_task(task);
+
+	task = htree_reconstruct_document_geometry_async(doc, 1);
+	htree_reconstruct_document_geometry(expected, 1);
+	printf("reconstruct: %d\n", htree_task_wait(task, -1));
+	printf("same as blocking: %s\n", same_documents(doc, expected) ? "yes" : "no");
+	htree_destroy_task(task);
+	htree_destroy_document(doc);
+	htree_destroy_document(expected);
+
+	/* the cancelled document is either untouched or fully converted */
+	doc = build_document(2000);
+	HTDocument* original = build_document(2000);
+	expected = build_document(2000);
+	htree_convert_document_geometry(expected, coordLocalCenter, coordLocalCenter, coordLocalCenter, edgeCenter);
+	task = htree_convert_document_geometry_async(doc, coordLocalCenter, coordLocalCenter,
+												 coordLocalCenter, edgeCenter);
+	htree_task_cancel(task);
+	int res = htree_task_wait(task, -1);
+	if (res == HTREE_CANCELLED) {
+		printf("cancelled: %s\n", same_documents(doc, original) ? "consistent" : "broken");
+	} else {
+		printf("cancelled: %s\n", same_documents(doc, expected) ? "consistent" : "broken");
+	}
+	htree_destroy_task(task);
+	
+	/* more tasks than the workers wait in the queue */
+	HTDocument* docs[16];
+	HTAsyncTask* tasks[16];
+	for (int i = 0; i < 16; i++) {
+		docs[i] = build_document(50);
+		tasks[i] = htree_convert_document_geometry_async(docs[i], coordLeftTop, coordLocalCenter,
+														 coordLeftTop, edgeCenter);
+	}
+	int converted = 0;
+	for (int i = 0; i < 16; i++) {
+		if (htree_task_wait(tasks[i], -1) == HTREE_OK && docs[i]->node_coord_format == coordLeftTop) {
+			converted++;
+		}
+		htree_destroy_task(tasks[i]);
+		htree_destroy_document(docs[i]);
+	}
+	printf("queued tasks converted: %d\n", converted);
+
+	printf("bad task: %d\n", htree_task_wait(NULL, 0));
+	htree_destroy_document(doc);
+	htree_destroy_document(original);
+	htree_destroy_document(expected);
+	return 0;
+}
@@ -0,0 +1,114 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+static void print_validation(const HTDocument* doc)
+{
+	HTValidation* v = NULL;
+	htree_validate_document(doc, &v);
+	printf("%zu issues\n", v->issues_count);
+	for (size_t i = 0; i < v->issues_count; i++) {
+		const HTIssue* issue = v->issues + i;
+		printf("  %s: %s (%s)\n", htree_issue_type_name(issue->type), issue->id,
+			   issue->edge ? "edge" : "node");
+	}
+	htree_destroy_validation(v);
+}
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = htree_new_node(htCompositeNode, "parent");
+	htree_node_set_rect(parent, 10, 10, 500, 300);
+	htree_add_node(tree, parent);
+	HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+	htree_node_set_rect(node0, 60, 160, 150, 100);
+	htree_add_child_node(parent, node0);
+	HTreeNode* node1 = htree_new_node(htSimpleNode, "node-1");
+	htree_node_set_rect(node1, 310, 60, 200, 150);
+	htree_add_child_node(parent, node1);
+	HTreeEdge* edge = htree_new_edge("e-0-1", "node-0", "node-1");
+	htree_edge_set_points(edge, 210, 210, 310, 135);
+	htree_add_edge(tree, edge);
+	htree_build_adjacency(tree);
+
+	printf("valid document: ");
+	print_validation(doc);
+
+	/* no geometry & duplicate id */
+	HTreeNode* node2 = htree_new_node(htSimpleNode, "node-1");
+	htree_add_child_node(parent, node2);
+	HTreeNode* node3 = htree_new_node(htSimpleNode, "node-3");
+	htree_add_node(tree, node3);
+	/* the edge from the node without geometry */
+	HTreeEdge* edge2 = htree_new_edge("e-3-0", "node-3", "node-0");
+	htree_edge_set_points(edge2, 0, 0, 60, 160);
+	htree_add_edge(tree, edge2);
+	/* dangling end, duplicate id */
+	htree_add_edge(tree, htree_new_edge("e-0-1", "node-0", "node-x"));
+	htree_build_adjacency(tree);
+	/* the edge added after the rebuild is bound on adding */
+	htree_add_edge(tree, htree_new_edge("e-1-0", "node-1", "node-0"));
+
+	printf("broken document: ");
+	print_validation(doc);
+
+	doc->edge_format = edgeNone;
+	printf("edge format none: ");
+	print_validation(doc);
+
+	htree_destroy_document(doc);
+
+	doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	/* the edge added before its nodes is resolved later */
+	htree_add_edge(tree, htree_new_edge("e-a-b", "a", "b"));
+	HTreeNode* a = htree_new_node(htSimpleNode, "a");
+	htree_node_set_rect(a, 0, 0, 10, 10);
+	htree_add_node(tree, a);
+	HTreeNode* b = htree_new_node(htSimpleNode, "b");
+	htree_node_set_rect(b, 20, 0, 10, 10);
+	htree_add_node(tree, b);
+	/* the second node with the same id is bound to its own edge */
+	HTreeNode* b2 = htree_new_node(htSimpleNode, "b");
+	htree_node_set_rect(b2, 40, 0, 10, 10);
+	htree_add_node(tree, b2);
+	HTreeEdge* edge3 = htree_new_edge("e-a-b2", "a", "b");
+	htree_bind_edge(edge3, a, b2);
+	htree_add_edge(tree, edge3);
+	/* the end bound to the node with another id */
+	HTreeEdge* edge4 = htree_new_edge("e-b-a", "b", "a");
+	htree_bind_edge(edge4, b, b);
+	htree_add_edge(tree, edge4);
+
+	printf("unbound ends: ");
+	print_validation(doc);
+
+	printf("bad parameter: %d\n", htree_validate_document(NULL, NULL));
+	htree_destroy_document(doc);
+	return 0;
+}
@@ -0,0 +1,86 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = htree_new_node(htCompositeNode, "parent");
+	htree_node_set_rect(parent, 10, 10, 500, 300);
+	htree_add_node(tree, parent);
+	HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+	htree_node_set_rect(node0, 60, 160, 150, 100);
+	htree_add_child_node(parent, node0);
+	HTreeNode* node1 = htree_new_node(htSimpleNode, "node-1");
+	htree_node_set_rect(node1, 310, 60, 200, 150);
+	htree_add_child_node(parent, node1);
+	HTreeNode* node2 = htree_new_node(htSimpleNode, "node-2");
+	htree_node_set_rect(node2, 600, 60, 100, 100);
+	htree_add_node(tree, node2);
+
+	htree_build_nodes_index(tree);
+	printf("nodes: %zu\n", tree->nodes_count);
+	for (size_t i = 0; i < tree->nodes_count; i++) {
+		HTreeNode* node = htree_node_by_index(tree, i);
+		printf("  %zu: %s\n", node->index, node->id);
+	}
+	printf("out of range: %s\n", htree_node_by_index(tree, 4) ? "found" : "not found");
+
+	/* the edges created by index are bound on adding */
+	htree_add_edge(tree, htree_new_edge_by_index(tree, "e-1-2", 1, 3));
+	printf("bad edge: %s\n", htree_new_edge_by_index(tree, "e-x", 1, 10) ? "created" : "not created");
+	/* the edges with the ids only are resolved in bulk */
+	htree_add_edge(tree, htree_new_edge("e-2-3", NULL, NULL));
+	htree_add_edge(tree, htree_new_edge("e-3-2", NULL, NULL));
+	size_t endpoints[] = {1, 3, 2, 3, 3, 2};
+	printf("resolve: %d\n", htree_resolve_edges_by_index(tree, endpoints, 3));
+	for (HTreeEdge* edge = tree->edges; edge; edge = edge->next) {
+		printf("  %s: %s -> %s (%s -> %s)\n", edge->id, edge->source_id, edge->target_id,
+			   edge->source->id, edge->target->id);
+	}
+	printf("node-2 in %zu out %zu\n", node2->in_edges_count, node2->out_edges_count);
+	size_t bad[] = {0, 7};
+	printf("resolve out of range: %d\n", htree_resolve_edges_by_index(tree, bad, 1));
+	printf("resolve too many: %d\n", htree_resolve_edges_by_index(tree, endpoints, 4));
+	/* the ids follow the nodes on rebinding */
+	size_t moved[] = {2, 1};
+	htree_resolve_edges_by_index(tree, moved, 1);
+	printf("rebound: %s -> %s\n", tree->edges->source_id, tree->edges->target_id);
+	htree_resolve_edges_by_index(tree, endpoints, 1);
+	printf("restored: %s -> %s\n", tree->edges->source_id, tree->edges->target_id);
+
+	/* the copy keeps the index */
+	HTDocument* copy = htree_copy_document(doc);
+	printf("copy: %zu nodes indexed, edge %s -> %s\n", copy->trees->nodes_count,
+		   copy->trees->edges->source->id, copy->trees->edges->target->id);
+	
+	htree_convert_document_geometry(doc, coordLeftTop, coordLeftTop, coordLeftTop, edgeCenter);
+	htree_print_document(doc);
+
+	htree_destroy_document(copy);
+	htree_destroy_document(doc);
+	return 0;
+}
@@ -0,0 +1,137 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "htgeom.h"
+
+static HTreeNode* add_node(HTree* tree, HTreeNode* parent, const char* id, HTNodeType type,
+						   double x, double y, double w, double h)
+{
+	HTreeNode* node = htree_new_node(type, id);
+	htree_node_set_rect_d(node, x, y, w, h);
+	if (parent) {
+		htree_add_child_node(parent, node);
+	} else {
+		htree_add_node(tree, node);
+	}
+	return node;
+}
+
+static void print_overlaps(const HTDocument* doc)
+{
+	HTOverlaps* o = NULL;
+	htree_find_overlaps(doc, &o);
+	printf("%zu overlaps\n", o->overlaps_count);
+	for (size_t i = 0; i < o->overlaps_count; i++) {
+		const HTOverlap* overlap = o->overlaps + i;
+		if (overlap->nodes[0]) {
+			printf("  nodes %s & %s in %s\n", overlap->nodes[0]->id, overlap->nodes[1]->id,
+				   overlap->parent ? overlap->parent->id : "the tree");
+		} else {
+			printf("  labels %s & %s\n", overlap->edges[0]->id, overlap->edges[1]->id);
+		}
+	}
+	htree_destroy_overlaps(o);
+}
+
+static size_t count_overlaps(const HTDocument* doc)
+{
+	HTOverlaps* o = NULL;
+	htree_find_overlaps(doc, &o);
+	size_t count = o->overlaps_count;
+	htree_destroy_overlaps(o);
+	return count;
+}
+
+/* the coordinates & sizes are multiples of 10 */
+static const char* compare_with_all_pairs(int count, int cells, int min_size, int max_size)
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	double (*rects)[4] = (double (*)[4])malloc(sizeof(double[4]) * count);
+	srand(1);
+	for (int i = 0; i < count; i++) {
+		char id[16];
+		snprintf(id, sizeof(id), "n%d", i);
+		rects[i][0] = 10 * (rand() % cells);
+		rects[i][1] = 10 * (rand() % cells);
+		rects[i][2] = 10 * (min_size + rand() % (max_size - min_size + 1));
+		rects[i][3] = 10 * (min_size + rand() % (max_size - min_size + 1));
+		add_node(tree, NULL, id, htSimpleNode, rects[i][0], rects[i][1], rects[i][2], rects[i][3]);
+	}
+	size_t expected = 0;
+	for (int i = 0; i < count; i++) {
+		for (int j = i + 1; j < count; j++) {
+			if (rects[i][0] < rects[j][0] + rects[j][2] && rects[j][0] < rects[i][0] + rects[i][2] &&
+				rects[i][1] < rects[j][1] + rects[j][3] && rects[j][1] < rects[i][1] + rects[i][3]) {
+				expected++;
+			}
+		}
+	}
+	size_t found = count_overlaps(doc);
+	free(rects);
+	htree_destroy_document(doc);
+	return found == expected ? "same as all pairs" : "differ";
+}
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = add_node(tree, NULL, "parent", htCompositeNode, 0, 0, 1000, 1000);
+	add_node(tree, parent, "a", htSimpleNode, 10, 10, 100, 100);
+	add_node(tree, parent, "b", htSimpleNode, 50, 50, 100, 100);
+	/* touching b */
+	add_node(tree, parent, "c", htSimpleNode, 150, 50, 100, 100);
+	HTreeNode* inner = add_node(tree, parent, "inner", htCompositeNode, 400, 400, 300, 300);
+	add_node(tree, inner, "d", htSimpleNode, 410, 410, 100, 100);
+	add_node(tree, inner, "e", htSimpleNode, 420, 480, 100, 100);
+	/* the column of nodes */
+	add_node(tree, inner, "f", htSimpleNode, 600, 410, 50, 40);
+	add_node(tree, inner, "g", htSimpleNode, 600, 450, 50, 40);
+	add_node(tree, NULL, "top", htSimpleNode, 900, 900, 200, 200);
+
+	HTreeEdge* e1 = htree_new_edge("e-a-c", "a", "c");
+	e1->label_rect = htree_new_rect_coord(100, 200, 80, 20);
+	htree_add_edge(tree, e1);
+	HTreeEdge* e2 = htree_new_edge("e-c-a", "c", "a");
+	e2->label_rect = htree_new_rect_coord(150, 210, 80, 20);
+	htree_add_edge(tree, e2);
+	htree_build_adjacency(tree);
+	htree_build_bounding_rect(doc, &(doc->bounding_rect));
+
+	print_overlaps(doc);
+
+	/* the result does not depend on the coordinates format */
+	htree_convert_document_geometry(doc, coordLocalCenter, coordLocalCenter, coordLocalCenter, edgeCenter);
+	print_overlaps(doc);
+	htree_destroy_document(doc);
+
+	/* compare with the all-pairs check */
+	printf("random rects: %s\n", compare_with_all_pairs(500, 200, 1, 7));
+	/* many rects share the sides, some are empty */
+	printf("grid rects: %s\n", compare_with_all_pairs(500, 40, 0, 3));
+	return 0;
+}
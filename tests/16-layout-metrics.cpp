@@ -0,0 +1,193 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "htgeom.h"
+
+static HTreeNode* add_node(HTree* tree, HTreeNode* parent, const char* id,
+						   double x, double y, double w, double h)
+{
+	HTreeNode* node = htree_new_node(parent || w > 100 ? htCompositeNode : htSimpleNode, id);
+	htree_node_set_rect_d(node, x, y, w, h);
+	if (parent) {
+		htree_add_child_node(parent, node);
+	} else {
+		htree_add_node(tree, node);
+	}
+	return node;
+}
+
+static void print_metrics(const HTDocument* doc)
+{
+	HTLayoutMetrics* m = NULL;
+	htree_layout_metrics(doc, &m);
+	for (size_t i = 0; i < m->trees_count; i++) {
+		printf("  tree %zu: %zu crossings, %zu edges through nodes\n", i,
+			   m->trees[i].edge_crossings, m->trees[i].edge_node_intersections);
+	}
+	printf("  total: %zu crossings, %zu edges through nodes\n",
+		   m->edge_crossings, m->edge_node_intersections);
+	htree_destroy_layout_metrics(m);
+}
+
+typedef struct {
+	double ax, ay, bx, by;
+	int edge;
+} Segment;
+
+static double cross(double ax, double ay, double bx, double by)
+{
+	return ax * by - ay * bx;
+}
+
+static int segments_cross(const Segment& s1, const Segment& s2)
+{
+	double d1x = s1.bx - s1.ax, d1y = s1.by - s1.ay;
+	double d2x = s2.bx - s2.ax, d2y = s2.by - s2.ay;
+	double den = cross(d1x, d1y, d2x, d2y);
+	if (den == 0.0) return 0;
+	double t = cross(s2.ax - s1.ax, s2.ay - s1.ay, d2x, d2y) / den;
+	double u = cross(s2.ax - s1.ax, s2.ay - s1.ay, d1x, d1y) / den;
+	return t > 0.0 && t < 1.0 && u > 0.0 && u < 1.0;
+}
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	/* a-d & b-c cross, a-c goes through m, the child edge leaves its parent */
+	add_node(tree, NULL, "a", 0, 0, 50, 50);
+	add_node(tree, NULL, "b", 300, 0, 50, 50);
+	add_node(tree, NULL, "c", 0, 300, 50, 50);
+	add_node(tree, NULL, "d", 300, 300, 50, 50);
+	add_node(tree, NULL, "m", 0, 150, 50, 50);
+	HTreeNode* p = add_node(tree, NULL, "p", 500, 0, 200, 200);
+	add_node(tree, p, "p-1", 550, 50, 50, 50);
+	htree_add_edge(tree, htree_new_edge("a-d", "a", "d"));
+	htree_add_edge(tree, htree_new_edge("b-c", "b", "c"));
+	htree_add_edge(tree, htree_new_edge("a-c", "a", "c"));
+	htree_add_edge(tree, htree_new_edge("p-1-d", "p-1", "d"));
+	/* the polyline crossing a-d twice */
+	HTreeEdge* edge = htree_new_edge("b-m", "b", "m");
+	edge->polyline = htree_new_polyline_coord(100, 25);
+	htree_polyline_add_point(edge->polyline, 250, 175);
+	htree_polyline_add_point(edge->polyline, 100, 175);
+	htree_add_edge(tree, edge);
+	htree_build_adjacency(tree);
+	htree_build_bounding_rect(doc, &(doc->bounding_rect));
+	printf("absolute:\n");
+	print_metrics(doc);
+
+	htree_convert_document_geometry(doc, coordLeftTop, coordLeftTop, coordLeftTop, edgeCenter);
+	printf("left-top:\n");
+	print_metrics(doc);
+	htree_destroy_document(doc);
+
+	/* the crossings at the bend points */
+	doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	add_node(tree, NULL, "l", 0, 100, 50, 50);
+	add_node(tree, NULL, "r", 400, 100, 50, 50);
+	add_node(tree, NULL, "t", 175, 0, 50, 50);
+	add_node(tree, NULL, "b", 175, 300, 50, 50);
+	add_node(tree, NULL, "t-2", 275, 0, 50, 50);
+	add_node(tree, NULL, "t-3", 335, 0, 50, 50);
+	htree_add_edge(tree, htree_new_edge("l-r", "l", "r"));
+	/* passes the bend on l-r */
+	edge = htree_new_edge("t-b", "t", "b");
+	edge->polyline = htree_new_polyline_coord(200, 125);
+	htree_add_edge(tree, edge);
+	/* touches l-r at the bend */
+	edge = htree_new_edge("t-2-t-3", "t-2", "t-3");
+	edge->polyline = htree_new_polyline_coord(320, 125);
+	htree_add_edge(tree, edge);
+	htree_build_adjacency(tree);
+	tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	add_node(tree, NULL, "x-1", 0, 400, 50, 50);
+	add_node(tree, NULL, "x-2", 400, 400, 50, 50);
+	add_node(tree, NULL, "x-3", 0, 550, 50, 50);
+	add_node(tree, NULL, "x-4", 400, 550, 50, 50);
+	add_node(tree, NULL, "y-1", 100, 300, 50, 50);
+	add_node(tree, NULL, "y-2", 300, 650, 50, 50);
+	/* the common bend point: v & ^ touch, y passes both */
+	edge = htree_new_edge("v", "x-1", "x-2");
+	edge->polyline = htree_new_polyline_coord(200, 500);
+	htree_add_edge(tree, edge);
+	edge = htree_new_edge("^", "x-3", "x-4");
+	edge->polyline = htree_new_polyline_coord(200, 500);
+	htree_add_edge(tree, edge);
+	edge = htree_new_edge("y", "y-1", "y-2");
+	edge->polyline = htree_new_polyline_coord(200, 500);
+	htree_add_edge(tree, edge);
+	htree_build_adjacency(tree);
+	htree_build_bounding_rect(doc, &(doc->bounding_rect));
+	printf("bend points:\n");
+	print_metrics(doc);
+	htree_destroy_document(doc);
+
+	/* compare the crossings with the all-pairs count */
+	doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	const int nodes = 300, edges = 400;
+	srand(2);
+	for (int i = 0; i < nodes; i++) {
+		char id[16];
+		snprintf(id, sizeof(id), "n%d", i);
+		add_node(tree, NULL, id, (rand() % 400) * 10, (rand() % 400) * 10, 20, 20);
+	}
+	for (int i = 0; i < edges; i++) {
+		char id[16], source[16], target[16];
+		snprintf(id, sizeof(id), "e%d", i);
+		snprintf(source, sizeof(source), "n%d", rand() % nodes);
+		snprintf(target, sizeof(target), "n%d", rand() % nodes);
+		htree_add_edge(tree, htree_new_edge(id, source, target));
+	}
+	htree_build_adjacency(tree);
+	std::vector<Segment> segments;
+	int index = 0;
+	for (HTreeEdge* e = tree->edges; e; e = e->next, index++) {
+		HTreePoint s, t;
+		if (htree_edge_absolute_points(doc, e, &s, &t, NULL) == 0) {
+			segments.push_back(Segment{s.x, s.y, t.x, t.y, index});
+		}
+	}
+	size_t expected = 0;
+	for (size_t i = 0; i < segments.size(); i++) {
+		for (size_t j = i + 1; j < segments.size(); j++) {
+			if (segments[i].edge != segments[j].edge && segments_cross(segments[i], segments[j])) {
+				expected++;
+			}
+		}
+	}
+	HTLayoutMetrics* m = NULL;
+	htree_layout_metrics(doc, &m);
+	printf("random edges: %s\n", m->edge_crossings == expected ? "same as all pairs" : "differ");
+	htree_destroy_layout_metrics(m);
+	htree_destroy_document(doc);
+	return 0;
+}
@@ -0,0 +1,133 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "htgeom.h"
+
+static HTreeNode* add_node(HTree* tree, const char* id, double x, double y, double w, double h)
+{
+	HTreeNode* node = htree_new_node(htSimpleNode, id);
+	htree_node_set_rect_d(node, x, y, w, h);
+	htree_add_node(tree, node);
+	return node;
+}
+
+static size_t count_label_overlaps(const HTDocument* doc)
+{
+	HTOverlaps* o = NULL;
+	size_t count = 0;
+	htree_find_overlaps(doc, &o);
+	for (size_t i = 0; i < o->overlaps_count; i++) {
+		if (o->overlaps[i].edges[0]) count++;
+	}
+	htree_destroy_overlaps(o);
+	return count;
+}
+
+static size_t count_labels_on_nodes(const HTDocument* doc)
+{
+	size_t count = 0;
+	for (const HTree* tree = doc->trees; tree; tree = tree->next) {
+		for (const HTreeEdge* e = tree->edges; e; e = e->next) {
+			if (!e->label_rect) continue;
+			const HTreeRect* l = e->label_rect;
+			for (const HTreeNode* n = tree->nodes; n; n = n->next) {
+				const HTreeRect* r = n->rect;
+				if (l->x < r->x + r->width && r->x < l->x + l->width &&
+					l->y < r->y + r->height && r->y < l->y + l->height) {
+					count++;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+int main()
+{
+	size_t conflicts = 0;
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	add_node(tree, "a", 0, 0, 100, 50);
+	add_node(tree, "b", 300, 0, 100, 50);
+	add_node(tree, "c", 0, 200, 100, 50);
+	/* the node in the middle of a-b */
+	add_node(tree, "m", 170, 0, 60, 50);
+	HTreeEdge* e1 = htree_new_edge("a-b", "a", "b");
+	e1->label_rect = htree_new_rect_coord(0, 0, 60, 20);
+	/* the label point moves with the rect */
+	e1->label_point = htree_new_point_coord(10, 5);
+	htree_add_edge(tree, e1);
+	HTreeEdge* e2 = htree_new_edge("b-a", "b", "a");
+	e2->label_rect = htree_new_rect_coord(0, 0, 60, 20);
+	htree_add_edge(tree, e2);
+	HTreeEdge* e3 = htree_new_edge("a-c", "a", "c");
+	e3->label_point = htree_new_point_coord(0, 0);
+	htree_add_edge(tree, e3);
+	htree_build_adjacency(tree);
+
+	printf("bad parameter: %d\n", htree_place_edge_labels(NULL, 0, 0, NULL));
+	printf("place: %d\n", htree_place_edge_labels(doc, 40, 16, &conflicts));
+	printf("conflicts: %zu\n", conflicts);
+	for (HTreeEdge* e = tree->edges; e; e = e->next) {
+		printf("%s: ", e->id);
+		htree_print_rect(e->label_rect);
+		if (e->label_point) {
+			printf(" point (%g, %g)", (double)e->label_point->x, (double)e->label_point->y);
+		}
+		printf("\n");
+	}
+	printf("labels overlap: %zu, labels on nodes: %zu\n",
+		   count_label_overlaps(doc), count_labels_on_nodes(doc));
+	htree_convert_document_geometry(doc, coordLeftTop, coordLeftTop, coordLeftTop, edgeCenter);
+	printf("left-top: %d\n", htree_place_edge_labels(doc, 40, 16, NULL));
+	htree_destroy_document(doc);
+
+	/* many labels */
+	doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	const int nodes = 200, edges = 300;
+	srand(3);
+	for (int i = 0; i < nodes; i++) {
+		char id[16];
+		snprintf(id, sizeof(id), "n%d", i);
+		add_node(tree, id, (i % 20) * 150, (i / 20) * 150, 40, 30);
+	}
+	for (int i = 0; i < edges; i++) {
+		char id[16], source[16], target[16];
+		int s = rand() % nodes;
+		int t = (s + 1 + rand() % 3) % nodes;
+		snprintf(id, sizeof(id), "e%d", i);
+		snprintf(source, sizeof(source), "n%d", s);
+		snprintf(target, sizeof(target), "n%d", t);
+		htree_add_edge(tree, htree_new_edge(id, source, target));
+	}
+	htree_build_adjacency(tree);
+	htree_place_edge_labels(doc, 30, 12, &conflicts);
+	printf("many labels: conflicts %zu, labels overlap %zu, labels on nodes %zu\n",
+		   conflicts, count_label_overlaps(doc), count_labels_on_nodes(doc));
+	htree_destroy_document(doc);
+	return 0;
+}
@@ -0,0 +1,140 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+static int check_links(const HTreeNode* nodes, const HTreeNode* parent)
+{
+	for (const HTreeNode* node = nodes; node; node = node->next) {
+		if (node->parent != parent) return 0;
+		for (size_t i = 0; i < node->out_edges_count; i++) {
+			if (node->out_edges[i]->source != node) return 0;
+		}
+		for (size_t i = 0; i < node->in_edges_count; i++) {
+			if (node->in_edges[i]->target != node) return 0;
+		}
+		if (!check_links(node->children, node)) return 0;
+	}
+	return 1;
+}
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordLeftTop, coordLeftTop, coordLeftTop, edgeCenter);
+	htree_enable_document_pool(doc);
+	htree_set_thread_document(doc);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = htree_new_node(htCompositeNode, "parent");
+	htree_node_set_rect(parent, 10, 10, 500, 300);
+	htree_add_node(tree, parent);
+	HTreeNode* node2 = htree_new_node(htSimpleNode, "node-2");
+	htree_node_set_rect(node2, 600, 60, 100, 100);
+	htree_add_node(tree, node2);
+	/* the children are allocated after the sibling */
+	HTreeNode* node0 = htree_new_node(htSimpleNode, "node-0");
+	htree_node_set_rect(node0, 50, 150, 150, 100);
+	htree_add_child_node(parent, node0);
+	HTreeNode* node1 = htree_new_node(htSimpleNode, "node-1");
+	htree_node_set_rect(node1, 300, 50, 150, 100);
+	htree_add_child_node(parent, node1);
+
+	HTreeEdge* edge = htree_new_edge("e-2-0", "node-2", "node-0");
+	edge->polyline = htree_new_polyline_coord(650, 300);
+	htree_polyline_add_point(edge->polyline, 135, 300);
+	htree_add_edge(tree, edge);
+	edge = htree_new_edge("e-0-1", "node-0", "node-1");
+	edge->label_rect = htree_new_rect_coord(200, 100, 40, 20);
+	htree_add_edge(tree, edge);
+	htree_add_edge(tree, htree_new_edge("e-1-2", "node-1", "node-2"));
+	htree_add_edge(tree, htree_new_edge("e-0-2", "node-0", "node-2"));
+	htree_build_adjacency(tree);
+	htree_build_nodes_index(tree);
+	htree_build_offsets_cache(doc);
+
+	HTreeRect before, after;
+	htree_node_absolute_rect(doc, node1, &before);
+
+	printf("compact: %d\n", htree_compact_document(doc));
+	printf("relocated: %s\n", tree->nodes != parent ? "yes" : "no");
+	printf("links: %s\n", check_links(tree->nodes, NULL) ? "ok" : "broken");
+	printf("nodes index:");
+	for (size_t i = 0; i < tree->nodes_count; i++) {
+		printf(" %s", htree_node_by_index(tree, i)->id);
+	}
+	printf("\n");
+	for (const HTreeEdge* e = tree->edges; e; e = e->next) {
+		printf("  %s: %s -> %s\n", e->id, e->source->id, e->target->id);
+	}
+	node1 = htree_node_by_index(tree, 2);
+	htree_node_absolute_rect(doc, node1, &after);
+	printf("cached rect kept: %s\n", before.x == after.x && before.y == after.y ? "yes" : "no");
+	htree_print_document(doc);
+
+	/* the nodes are placed one after another */
+	int ordered = 1;
+	for (size_t i = 1; i < tree->nodes_count; i++) {
+		const char* prev = (const char*)htree_node_by_index(tree, i - 1);
+		const char* next = (const char*)htree_node_by_index(tree, i);
+		if (next <= prev || next - prev > 1024) ordered = 0;
+	}
+	printf("nodes contiguous: %s\n", ordered ? "yes" : "no");
+	ordered = 1;
+	for (const HTreeEdge* e = tree->edges; e && e->next; e = e->next) {
+		if ((const char*)e->next <= (const char*)e) ordered = 0;
+	}
+	printf("edges in the list order: %s\n", ordered ? "yes" : "no");
+
+	/* the old objects stay in the pool */
+	HTMemoryUsage usage;
+	htree_document_memory_usage(doc, &usage);
+	printf("pool kept: %s\n", usage.pooled > 0 ? "yes" : "no");
+
+	/* the edge bound to the node of the other tree */
+	HTree* other = htree_new_tree();
+	htree_add_tree(doc, other);
+	HTreeNode* node3 = htree_new_node(htSimpleNode, "node-3");
+	htree_node_set_rect(node3, 800, 60, 100, 100);
+	htree_add_node(other, node3);
+	edge = htree_new_edge("e-3-0", "node-3", "node-0");
+	htree_add_edge(other, edge);
+	htree_bind_edge(edge, node3, htree_node_by_index(tree, 1));
+	printf("compact the trees: %d\n", htree_compact_document(doc));
+	edge = other->edges;
+	printf("cross-tree edge: %s -> %s, %s\n", edge->source->id, edge->target->id,
+		   edge->target == htree_node_by_index(tree, 1) && edge->target->in_edges[edge->target->in_edges_count - 1] == edge &&
+		   other->nodes->out_edges[0] == edge ? "bound" : "broken");
+	printf("links: %s\n", check_links(tree->nodes, NULL) && check_links(other->nodes, NULL) ? "ok" : "broken");
+	/* the compacted objects are freed one by one */
+	for (HTreeEdge* e = tree->edges; e; e = e->next) {
+		if (e->polyline) {
+			htree_destroy_polyline(e->polyline);
+			e->polyline = NULL;
+		}
+	}
+
+	htree_set_thread_document(NULL);
+	htree_destroy_document(doc);
+	printf("compact NULL: %d\n", htree_compact_document(NULL));
+	return 0;
+}
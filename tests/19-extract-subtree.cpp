@@ -0,0 +1,112 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+static HTDocument* build_document(HTCoordFormat format)
+{
+	HTDocument* doc = htree_new_document(format, format, format, edgeCenter);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* machine = htree_new_node(htCompositeNode, "machine");
+	htree_node_set_rect(machine, 10, 10, 800, 500);
+	htree_add_node(tree, machine);
+	HTreeNode* state = htree_new_node(htCompositeNode, "state");
+	htree_node_set_rect(state, 100, 100, 400, 300);
+	htree_add_child_node(machine, state);
+	HTreeNode* init = htree_new_node(htPoint, "init");
+	htree_node_set_point(init, 20, 20);
+	htree_add_child_node(state, init);
+	HTreeNode* a = htree_new_node(htSimpleNode, "a");
+	htree_node_set_rect(a, 50, 50, 100, 60);
+	htree_add_child_node(state, a);
+	HTreeNode* b = htree_new_node(htSimpleNode, "b");
+	htree_node_set_rect(b, 250, 150, 100, 60);
+	htree_add_child_node(state, b);
+	HTreeNode* outside = htree_new_node(htSimpleNode, "outside");
+	htree_node_set_rect(outside, 600, 100, 100, 60);
+	htree_add_child_node(machine, outside);
+
+	htree_add_edge(tree, htree_new_edge("e-init-a", "init", "a"));
+	HTreeEdge* edge = htree_new_edge("e-a-b", "a", "b");
+	edge->polyline = htree_new_polyline_coord(10, 80);
+	edge->label_rect = htree_new_rect_coord(60, 70, 30, 10);
+	htree_add_edge(tree, edge);
+	htree_add_edge(tree, htree_new_edge("e-b-outside", "b", "outside"));
+	htree_add_edge(tree, htree_new_edge("e-outside-a", "outside", "a"));
+	htree_build_adjacency(tree);
+	return doc;
+}
+
+static void extract(const char* title, HTCoordFormat format, int rebase)
+{
+	HTDocument* doc = build_document(format);
+	htree_convert_document_geometry(doc, format, format, format, edgeCenter);
+	HTreeNode* state = doc->trees->nodes->children;
+	HTree* tree = NULL;
+	printf("%s: %d\n", title, htree_extract_subtree(doc, state, rebase, &tree));
+	HTDocument* sub = htree_new_document(format, format, format, edgeCenter);
+	htree_add_tree(sub, tree);
+
+	HTreeRect src, dst;
+	htree_node_absolute_rect(doc, state->children->next->next, &src);
+	htree_node_absolute_rect(sub, tree->nodes->children->next->next, &dst);
+	printf("  b moved by (%g, %g)\n", dst.x - src.x, dst.y - src.y);
+	htree_convert_document_geometry(sub, coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	htree_print_document(sub);
+
+	htree_destroy_document(sub);
+	htree_destroy_document(doc);
+}
+
+int main()
+{
+	extract("absolute", coordAbsolute, 0);
+	extract("absolute rebased", coordAbsolute, 1);
+	extract("left-top", coordLeftTop, 0);
+	extract("left-top rebased", coordLeftTop, 1);
+	extract("local-center rebased", coordLocalCenter, 1);
+
+	/* the edges added before their nodes are not bound */
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeCenter);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	htree_add_edge(tree, htree_new_edge("e-a-b", "a", "b"));
+	htree_add_edge(tree, htree_new_edge("e-b-outside", "b", "outside"));
+	HTreeNode* state = htree_new_node(htCompositeNode, "state");
+	htree_add_node(tree, state);
+	htree_add_child_node(state, htree_new_node(htSimpleNode, "a"));
+	htree_add_child_node(state, htree_new_node(htSimpleNode, "b"));
+	htree_add_node(tree, htree_new_node(htSimpleNode, "outside"));
+	HTree* sub = NULL;
+	printf("unbound edges: %d\n", htree_extract_subtree(doc, state, 0, &sub));
+	for (const HTreeEdge* edge = sub->edges; edge; edge = edge->next) {
+		printf("  %s: %s -> %s\n", edge->id, edge->source->id, edge->target->id);
+	}
+	htree_destroy_tree(sub);
+	htree_destroy_document(doc);
+
+	tree = NULL;
+	printf("bad parameter: %d\n", htree_extract_subtree(NULL, NULL, 0, &tree));
+	return 0;
+}
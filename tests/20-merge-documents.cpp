@@ -0,0 +1,165 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "htgeom.h"
+
+typedef struct {
+	long        allocated;
+	long        freed;
+} Counter;
+
+static void* counting_alloc(size_t size, void* context)
+{
+	((Counter*)context)->allocated++;
+	return malloc(size);
+}
+
+static void counting_free(void* ptr, void* context)
+{
+	((Counter*)context)->freed++;
+	free(ptr);
+}
+
+static HTDocument* build_document(HTCoordFormat format, const char* parent_id, const char* child_id,
+								  double x, double y)
+{
+	HTDocument* doc = htree_new_document(format, format, format, edgeCenter);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = htree_new_node(htCompositeNode, parent_id);
+	htree_node_set_rect(parent, x, y, 300, 200);
+	htree_add_node(tree, parent);
+	HTreeNode* child = htree_new_node(htSimpleNode, child_id);
+	htree_node_set_rect(child, 20, 20, 100, 50);
+	htree_add_child_node(parent, child);
+	htree_add_edge(tree, htree_new_edge("e", parent_id, child_id));
+	htree_build_adjacency(tree);
+	htree_build_bounding_rect(doc, &(doc->bounding_rect));
+	return doc;
+}
+
+int main()
+{
+	size_t conflicts = 0;
+	HTDocument* dst = build_document(coordAbsolute, "a", "b", 0, 0);
+	HTDocument* srcs[3];
+
+	/* nothing is merged on the collision */
+	srcs[0] = build_document(coordLeftTop, "c", "d", 400, 0);
+	srcs[1] = build_document(coordLeftTop, "c", "a", 800, 0);
+	int res = htree_merge_documents(dst, srcs, 2, mergeFail, &conflicts);
+	printf("fail: %d, conflicts %zu\n", res, conflicts);
+	printf("  sources kept: %s\n", srcs[0]->trees && srcs[1]->trees ? "yes" : "no");
+	printf("  sources format: %d %d\n", srcs[0]->node_coord_format, srcs[1]->node_coord_format);
+
+	/* the document having the colliding ids is skipped */
+	res = htree_merge_documents(dst, srcs + 1, 1, mergeSkipDocument, &conflicts);
+	printf("skip: %d, conflicts %zu\n", res, conflicts);
+	printf("  source kept: %s, format %d\n", srcs[1]->trees ? "yes" : "no", srcs[1]->node_coord_format);
+	htree_destroy_document(srcs[1]);
+
+	/* the document allocated by the other allocator is copied */
+	Counter counter = {0, 0};
+	HTAllocator allocator = {counting_alloc, counting_free, &counter};
+	htree_set_thread_allocator(&allocator);
+	srcs[1] = build_document(coordLocalCenter, "a", "d", 0, 400);
+	htree_set_thread_allocator(NULL);
+	srcs[2] = build_document(coordAbsolute, "a", "b", 400, 400);
+	/* the source in the same formats is not copied */
+	HTree* moved = srcs[2]->trees;
+
+	res = htree_merge_documents(dst, srcs, 3, mergeRenameIds, &conflicts);
+	printf("rename: %d, conflicts %zu\n", res, conflicts);
+	printf("  tree moved: %s\n", dst->trees->next->next->next == moved ? "yes" : "no");
+	printf("  sources empty: %s\n", !srcs[0]->trees && !srcs[1]->trees && !srcs[2]->trees ? "yes" : "no");
+	for (int i = 0; i < 3; i++) {
+		htree_destroy_document(srcs[i]);
+	}
+	printf("  other allocator balanced: %s\n", counter.allocated == counter.freed ? "yes" : "no");
+	htree_print_document(dst);
+
+	HTValidation* validation = NULL;
+	htree_validate_document(dst, &validation);
+	printf("issues: %zu\n", validation->issues_count);
+	for (size_t i = 0; i < validation->issues_count; i++) {
+		printf("  %s %s\n", htree_issue_type_name(validation->issues[i].type), validation->issues[i].id);
+	}
+	htree_destroy_validation(validation);
+	htree_destroy_document(dst);
+
+	/* the top level of the local center documents keeps its absolute position */
+	dst = build_document(coordLocalCenter, "a", "b", 0, 0);
+	srcs[0] = build_document(coordLocalCenter, "c", "d", 1000, 0);
+	HTreeNode* a = dst->trees->nodes;
+	HTreeNode* c = srcs[0]->trees->nodes;
+	HTreeRect before_a, before_c, after_a, after_c;
+	htree_node_absolute_rect(dst, a, &before_a);
+	htree_node_absolute_rect(srcs[0], c, &before_c);
+	res = htree_merge_documents(dst, srcs, 1, mergeKeepIds, &conflicts);
+	htree_destroy_document(srcs[0]);
+	htree_node_absolute_rect(dst, a, &after_a);
+	/* the source was converted in a copy */
+	c = dst->trees->next->nodes;
+	htree_node_absolute_rect(dst, c, &after_c);
+	printf("local center: %d, a (%g, %g) -> (%g, %g), c (%g, %g) -> (%g, %g)\n", res,
+		   before_a.x, before_a.y, after_a.x, after_a.y, before_c.x, before_c.y, after_c.x, after_c.y);
+	htree_destroy_document(dst);
+
+	/* the ids are unique in the document, the source repeating its own ids has no conflicts */
+	dst = build_document(coordAbsolute, "a", "b", 0, 0);
+	srcs[0] = build_document(coordAbsolute, "x", "y", 400, 0);
+	HTDocument* second = build_document(coordAbsolute, "x", "z", 800, 0);
+	htree_add_tree(srcs[0], second->trees);
+	second->trees = NULL;
+	htree_destroy_document(second);
+	res = htree_merge_documents(dst, srcs, 1, mergeRenameIds, &conflicts);
+	printf("source duplicates: %d, conflicts %zu\n", res, conflicts);
+	htree_destroy_document(srcs[0]);
+	htree_validate_document(dst, &validation);
+	printf("issues: %zu\n", validation->issues_count);
+	for (size_t i = 0; i < validation->issues_count; i++) {
+		printf("  %s %s\n", htree_issue_type_name(validation->issues[i].type), validation->issues[i].id);
+	}
+	htree_destroy_validation(validation);
+	htree_destroy_document(dst);
+
+	/* the edge of the other source tree gets the renamed id */
+	dst = build_document(coordAbsolute, "a", "b", 0, 0);
+	srcs[0] = build_document(coordAbsolute, "a", "d", 400, 0);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(srcs[0], tree);
+	HTreeNode* node = htree_new_node(htSimpleNode, "c");
+	htree_node_set_rect(node, 800, 0, 100, 50);
+	htree_add_node(tree, node);
+	htree_add_edge(tree, htree_new_edge("c-a", "c", "a"));
+	res = htree_merge_documents(dst, srcs, 1, mergeRenameIds, &conflicts);
+	htree_destroy_document(srcs[0]);
+	const HTreeEdge* edge = dst->trees->next->next->edges;
+	printf("other tree: %d, %s -> %s, renamed %s\n", res, edge->source_id, edge->target_id,
+		   dst->trees->next->nodes->id);
+	htree_destroy_document(dst);
+
+	printf("bad parameter: %d\n", htree_merge_documents(NULL, srcs, 1, mergeKeepIds, NULL));
+	return 0;
+}
@@ -0,0 +1,91 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+static HTreeNode* add_node(HTree* tree, HTreeNode* parent, HTNodeType type, const char* id,
+						   double x, double y, double w, double h)
+{
+	HTreeNode* node = htree_new_node(type, id);
+	htree_node_set_rect_d(node, x, y, w, h);
+	if (parent) {
+		htree_add_child_node(parent, node);
+	} else {
+		htree_add_node(tree, node);
+	}
+	return node;
+}
+
+static void query(const HTDocument* doc, const HTreeRect* viewport, double zoom)
+{
+	HTViewport* v = NULL;
+	printf("zoom %g: %d\n", zoom, htree_query_viewport(doc, viewport, zoom, 50, &v));
+	printf("  nodes:");
+	for (size_t i = 0; i < v->nodes_count; i++) printf(" %s", v->nodes[i]->id);
+	printf("\n  collapsed:");
+	for (size_t i = 0; i < v->collapsed_nodes_count; i++) printf(" %s", v->collapsed_nodes[i]->id);
+	printf("\n  edges:");
+	for (size_t i = 0; i < v->edges_count; i++) printf(" %s", v->edges[i]->id);
+	printf("\n");
+	htree_destroy_viewport(v);
+}
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeCenter);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* big = add_node(tree, NULL, htCompositeNode, "big", 0, 0, 400, 300);
+	add_node(tree, big, htSimpleNode, "a", 20, 20, 100, 60);
+	add_node(tree, big, htSimpleNode, "b", 200, 150, 100, 60);
+	/* the composite smaller than 50 pixels at zoom 1 */
+	HTreeNode* small = add_node(tree, NULL, htCompositeNode, "small", 500, 0, 40, 30);
+	add_node(tree, small, htSimpleNode, "s1", 505, 5, 10, 10);
+	add_node(tree, small, htSimpleNode, "s2", 520, 15, 10, 10);
+	/* the long and thin composite is collapsed by its area */
+	HTreeNode* strip = add_node(tree, NULL, htCompositeNode, "strip", 0, 400, 1000, 2);
+	add_node(tree, strip, htSimpleNode, "t1", 10, 400, 10, 2);
+	/* the node outside of the viewport */
+	add_node(tree, NULL, htSimpleNode, "far", 2000, 2000, 50, 50);
+
+	htree_add_edge(tree, htree_new_edge("a-b", "a", "b"));
+	htree_add_edge(tree, htree_new_edge("s1-s2", "s1", "s2"));
+	htree_add_edge(tree, htree_new_edge("a-s1", "a", "s1"));
+	htree_add_edge(tree, htree_new_edge("far-far", "far", "far"));
+	htree_build_adjacency(tree);
+
+	HTreeRect viewport = {0, 0, 800, 600};
+	query(doc, &viewport, 1.0);
+	query(doc, &viewport, 2.0);
+	HTreeRect corner = {0, 0, 150, 100};
+	query(doc, &corner, 1.0);
+
+	HTViewport* v = NULL;
+	printf("bad zoom: %d\n", htree_query_viewport(doc, &viewport, 0.0, 50, &v));
+	htree_convert_document_geometry(doc, coordLeftTop, coordLeftTop, coordLeftTop, edgeCenter);
+	printf("relative format:\n");
+	query(doc, &viewport, 1.0);
+	query(doc, &corner, 1.0);
+	htree_destroy_document(doc);
+	return 0;
+}
@@ -0,0 +1,104 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <stdio.h>
+#include "htgeom.h"
+
+static void print_counts(const char* title, const HTreeNode* a, const HTreeNode* b)
+{
+	printf("%s: a in %zu out %zu, b in %zu out %zu\n", title,
+		   a->in_edges_count, a->out_edges_count, b->in_edges_count, b->out_edges_count);
+}
+
+int main()
+{
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeCenter);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* a = htree_new_node(htSimpleNode, "a");
+	htree_node_set_rect(a, 0, 0, 100, 50);
+	htree_add_node(tree, a);
+	HTreeNode* b = htree_new_node(htSimpleNode, "b");
+	htree_node_set_rect(b, 200, 0, 100, 50);
+	htree_add_node(tree, b);
+
+	/* the bound edge is not indexed twice on adding */
+	HTreeEdge* e = htree_new_edge("a-b", "a", "b");
+	htree_bind_edge(e, a, b);
+	htree_add_edge(tree, e);
+	print_counts("bind & add", a, b);
+
+	htree_bind_edge(e, b, a);
+	print_counts("rebind", a, b);
+	printf("  a in: %s\n", a->in_edges[0]->id);
+
+	HTreeEdge* loop = htree_new_edge("b-b", "b", "b");
+	htree_add_edge(tree, loop);
+	htree_bind_edge(loop, b, b);
+	print_counts("loop", a, b);
+	htree_build_adjacency(tree);
+	print_counts("rebuild", a, b);
+
+	/* the destroyed edge leaves the index */
+	tree->edges->next = NULL;
+	htree_destroy_edge(loop);
+	print_counts("destroy", a, b);
+	HTree* sub = NULL;
+	htree_extract_subtree(doc, b, 0, &sub);
+	printf("extracted edges: %s\n", sub->edges ? sub->edges->id : "none");
+	htree_destroy_tree(sub);
+
+	htree_unbind_edge(e);
+	print_counts("unbind", a, b);
+
+	/* the ends are resolved by the ids on adding */
+	HTreeEdge* by_ids = htree_new_edge("b-a", "b", "a");
+	htree_add_edge(tree, by_ids);
+	print_counts("add by ids", a, b);
+
+	/* rebuilding the tree index keeps the edges of the other trees */
+	HTree* other = htree_new_tree();
+	htree_add_tree(doc, other);
+	HTreeNode* c = htree_new_node(htSimpleNode, "c");
+	htree_add_node(other, c);
+	HTreeEdge* cross = htree_new_edge("c-a", "c", "a");
+	htree_bind_edge(cross, c, a);
+	htree_add_edge(other, cross);
+	htree_build_adjacency(tree);
+	print_counts("rebuild with other tree", a, b);
+
+	/* the destroyed node leaves its edges unbound */
+	HTreeNode* d = htree_new_node(htSimpleNode, "d");
+	htree_add_node(tree, d);
+	HTreeEdge* to_d = htree_new_edge("a-d", "a", "d");
+	htree_add_edge(tree, to_d);
+	print_counts("add node d", a, b);
+	b->next = NULL;
+	htree_destroy_node(d);
+	printf("destroy node: source %s, target %s\n",
+		   to_d->source ? to_d->source->id : "none", to_d->target ? to_d->target->id : "none");
+	by_ids->next = NULL;
+	htree_destroy_edge(to_d);
+	print_counts("destroy edge", a, b);
+	htree_destroy_document(doc);
+	return 0;
+}
@@ -0,0 +1,89 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada Hierarchical Tree Geometry library implemention
+ *
+ * The the hierarchiceal tree geometry library
+ *
+ * Copyright (C) 2024 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ * ----------------------------------------------------------------------------- */
+
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include "htgeom.h"
+
+/* the relative error allowed by the coordinates storage type */
+static int near_value(double stored, double value, double scale)
+{
+	double eps = sizeof(htree_coord_t) == sizeof(float) ? FLT_EPSILON : DBL_EPSILON;
+	return fabs(stored - value) <= 4 * eps * (fabs(scale) > 1.0 ? fabs(scale) : 1.0);
+}
+
+static void check(const char* title, int ok)
+{
+	printf("%s: %s\n", title, ok ? "ok" : "FAILED");
+}
+
+int main()
+{
+	const double x = 100000.3, y = -2500.125, w = 0.1, h = 1234.5678;
+
+	HTreePoint* p = htree_new_point_coord_d(x, y);
+	check("point", near_value(p->x, x, x) && near_value(p->y, y, y));
+	htree_destroy_point(p);
+
+	HTreeRect* r = htree_new_rect_coord_d(x, y, w, h);
+	check("rect", near_value(r->x, x, x) && near_value(r->y, y, y) && near_value(r->width, w, w) && near_value(r->height, h, h));
+	htree_destroy_rect(r);
+
+	HTreePolyline* pl = htree_new_polyline_coord_d(x, y);
+	htree_polyline_add_point_d(pl, w, h);
+	check("polyline", near_value(pl->point.x, x, x) && near_value(pl->next->point.y, h, h));
+	htree_destroy_polyline(pl);
+
+	/* the exactly representable values are kept as is */
+	p = htree_new_point_coord_d(1024.25, -0.5);
+	check("exact", p->x == 1024.25 && p->y == -0.5);
+	htree_destroy_point(p);
+
+	HTDocument* doc = htree_new_document(coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	HTree* tree = htree_new_tree();
+	htree_add_tree(doc, tree);
+	HTreeNode* parent = htree_new_node(htCompositeNode, "parent");
+	htree_node_set_rect_d(parent, x, y, 1000.75, 800.25);
+	htree_add_node(tree, parent);
+	HTreeNode* child = htree_new_node(htSimpleNode, "child");
+	htree_node_set_rect_d(child, x + 50.7, y + 20.3, w, h);
+	htree_add_child_node(parent, child);
+	HTreeNode* point = htree_new_node(htPoint, "point");
+	htree_node_set_point_d(point, x + 10.1, y + 10.1);
+	htree_add_child_node(parent, point);
+	HTreeEdge* edge = htree_new_edge("e", "point", "child");
+	htree_edge_set_points_d(edge, x + 10.1, y + 10.1, x + 50.7, y + 30.3);
+	htree_add_edge(tree, edge);
+	htree_build_adjacency(tree);
+	check("node setters", near_value(child->rect->x, x + 50.7, x) && near_value(point->point->y, y + 10.1, x));
+	check("edge setters", near_value(edge->source_point->x, x + 10.1, x) && near_value(edge->target_point->y, y + 30.3, x));
+
+	/* the round trip through the relative formats keeps the precision of the type */
+	htree_convert_document_geometry(doc, coordLeftTop, coordLeftTop, coordLeftTop, edgeCenter);
+	htree_convert_document_geometry(doc, coordLocalCenter, coordLocalCenter, coordLocalCenter, edgeCenter);
+	htree_convert_document_geometry(doc, coordAbsolute, coordAbsolute, coordAbsolute, edgeBorder);
+	check("round trip", near_value(parent->rect->x, x, 4 * x) && near_value(child->rect->x, x + 50.7, 4 * x) &&
+		  near_value(child->rect->y, y + 20.3, 4 * x) && near_value(point->point->x, x + 10.1, 4 * x));
+	htree_destroy_document(doc);
+	return 0;
+}